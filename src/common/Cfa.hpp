@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+//Bayer color filter array patterns, colors of the 2x2 cell from the top left sample
+enum ECfaPattern
+{
+  eCfaNone = 0, //not a mosaic, one pixel has all the channels
+  eCfaRGGB,
+  eCfaBGGR,
+  eCfaGRBG,
+  eCfaGBRG
+};
+
+/**
+ * @brief Color (0 red, 1 green, 2 blue) of a mosaic sample
+ * Coordinates are pixel coordinates, the pattern cell starts at (0, 0).
+ * @param[in] pattern
+ * @param[in] x
+ * @param[in] y
+ */
+inline std::size_t getCfaColor(ECfaPattern pattern, int x, int y)
+{
+  //colors of the cell samples (0, 0), (1, 0), (0, 1), (1, 1)
+  static const std::size_t colors[5][4] = {{0, 1, 1, 2},  //none, unused
+                                           {0, 1, 1, 2},  //RGGB
+                                           {2, 1, 1, 0},  //BGGR
+                                           {1, 0, 2, 1},  //GRBG
+                                           {1, 2, 0, 1}}; //GBRG
+  return colors[pattern][(x & 1) + 2 * (y & 1)];
+}
+
+} // namespace common
+} // namespace cameraColorCalibration
@@ -0,0 +1,166 @@
+#include "ColorStage.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+ColorStage::ColorStage() :
+  _whiteBalance{{1.f, 1.f, 1.f}},
+  _matrix{{1.f, 0.f, 0.f,
+           0.f, 1.f, 0.f,
+           0.f, 0.f, 1.f}}
+{
+  update();
+}
+
+void ColorStage::setWhiteBalance(float red, float green, float blue)
+{
+  _whiteBalance = {{red, green, blue}};
+  update();
+}
+
+void ColorStage::setMatrix(const std::array<float, 9> &matrix)
+{
+  _matrix = matrix;
+  update();
+}
+
+void ColorStage::setToneMap(float exposure, float whitePoint)
+{
+  _toneMapped = true;
+  _exposure = exposure;
+  //an infinite white point is the plain Reinhard curve
+  _inverseWhite2 = (whitePoint > 0.f) ? 1.f / (whitePoint * whitePoint) : 0.f;
+  updateToneMap();
+}
+
+void ColorStage::setLogAverage(float logAverage)
+{
+  _logAverage = logAverage;
+  updateToneMap();
+}
+
+void ColorStage::updateToneMap()
+{
+  const float key = 0.18f * std::pow(2.f, _exposure);
+  _toneScale = (_logAverage > 0.f) ? key / _logAverage : key;
+}
+
+void ColorStage::update()
+{
+  _identityColor = true;
+  for(std::size_t row = 0; row < 3; ++row)
+  {
+    for(std::size_t column = 0; column < 3; ++column)
+    {
+      const float value = _matrix[row * 3 + column] * _whiteBalance[column];
+      _colorMatrix[row * 3 + column] = value;
+      _identityColor = _identityColor && (value == ((row == column) ? 1.f : 0.f));
+    }
+  }
+}
+
+void ColorStage::applyPixel(float *pixel, int x, int y) const
+{
+  float r = pixel[0];
+  float g = pixel[1];
+  float b = pixel[2];
+
+  if(_flatField != nullptr)
+  {
+    const OfxRectI bounds = _flatField->getBounds();
+    if((x >= bounds.x1) && (x < bounds.x2) && (y >= bounds.y1) && (y < bounds.y2))
+    {
+      //a single channel gain applies to the 3 channels
+      const float *ptrGain = _flatField->getPixel(static_cast<std::size_t>(x - bounds.x1), static_cast<std::size_t>(y - bounds.y1));
+      const std::size_t step = (_flatField->getNbChannels() >= 3) ? 1 : 0;
+      r *= ptrGain[0];
+      g *= ptrGain[step];
+      b *= ptrGain[2 * step];
+    }
+  }
+
+  const std::array<float, 9> &m = _colorMatrix;
+  pixel[0] = m[0] * r + m[1] * g + m[2] * b;
+  pixel[1] = m[3] * r + m[4] * g + m[5] * b;
+  pixel[2] = m[6] * r + m[7] * g + m[8] * b;
+}
+
+void ColorStage::applyRow(float *row, std::size_t nbChannels, std::size_t width, int x, int y) const
+{
+  assert(nbChannels >= 3);
+
+  if(isIdentity())
+  {
+    return;
+  }
+
+  //columns of the row covered by the gain image
+  std::size_t gainBegin = width;
+  std::size_t gainEnd = width;
+  const float *gain = nullptr;
+  std::size_t gainChannels = 0;
+
+  if(_flatField != nullptr)
+  {
+    const OfxRectI bounds = _flatField->getBounds();
+    if((y >= bounds.y1) && (y < bounds.y2))
+    {
+      const int begin = std::min(std::max(bounds.x1 - x, 0), static_cast<int>(width));
+      const int end = std::max(std::min(bounds.x2 - x, static_cast<int>(width)), begin);
+      gainBegin = static_cast<std::size_t>(begin);
+      gainEnd = static_cast<std::size_t>(end);
+      gainChannels = _flatField->getNbChannels();
+      if(gainBegin < gainEnd)
+      {
+        gain = _flatField->getPixel(static_cast<std::size_t>(x + begin - bounds.x1), static_cast<std::size_t>(y - bounds.y1));
+      }
+    }
+  }
+
+  const std::array<float, 9> &m = _colorMatrix;
+
+  for(std::size_t i = 0; i < width; ++i)
+  {
+    float *ptr = row + i * nbChannels;
+    float r = ptr[0];
+    float g = ptr[1];
+    float b = ptr[2];
+
+    if((i >= gainBegin) && (i < gainEnd))
+    {
+      //a single channel gain applies to the 3 channels
+      const float *ptrGain = gain + (i - gainBegin) * gainChannels;
+      const std::size_t step = (gainChannels >= 3) ? 1 : 0;
+      r *= ptrGain[0];
+      g *= ptrGain[step];
+      b *= ptrGain[2 * step];
+    }
+
+    const float red = m[0] * r + m[1] * g + m[2] * b;
+    const float green = m[3] * r + m[4] * g + m[5] * b;
+    const float blue = m[6] * r + m[7] * g + m[8] * b;
+
+    if(!_toneMapped)
+    {
+      ptr[0] = red;
+      ptr[1] = green;
+      ptr[2] = blue;
+      continue;
+    }
+
+    //the chromaticity is kept, negative and NaN luminances go to black
+    const float luminance = 0.2126f * red + 0.7152f * green + 0.0722f * blue;
+    const float scaled = _toneScale * luminance;
+    const float ratio = (luminance > 0.f) ? _toneScale * (1.f + scaled * _inverseWhite2) / (1.f + scaled) : 0.f;
+    ptr[0] = red * ratio;
+    ptr[1] = green * ratio;
+    ptr[2] = blue * ratio;
+  }
+}
+
+} // namespace common
+} // namespace cameraColorCalibration
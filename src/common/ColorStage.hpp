@@ -0,0 +1,143 @@
+#pragma once
+#include "Image.hpp"
+#include <array>
+#include <cstddef>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+/**
+ * @brief Color corrections of the merged radiance: flat-field gain, white balance and color matrix
+ * Applied to each row right after the merge writes it, while the row is still in cache,
+ * instead of a separate pass over the whole radiance for each correction.
+ * The white balance and the matrix are folded in a single 3x3 matrix:
+ *   output = matrix * diag(whiteBalance) * (gain * radiance)
+ * An optional global Reinhard operator then maps the output luminance to a display range.
+ */
+class ColorStage
+{
+public:
+
+  ColorStage();
+
+  /**
+   * @brief Per pixel gain image, multiplied to the radiance before the white balance
+   * A single channel image is a gain for the 3 channels, an RGB(A) image a gain per channel.
+   * Pixels outside the gain image bounds keep their radiance.
+   * @param[in] gain - image in the pixel coordinates of the radiance, null disables the flat-field
+   */
+  void setFlatField(const Image<float> *gain)
+  {
+    _flatField = gain;
+  }
+
+  /**
+   * @brief White balance multipliers of the radiance channels
+   * @param[in] red
+   * @param[in] green
+   * @param[in] blue
+   */
+  void setWhiteBalance(float red, float green, float blue);
+
+  /**
+   * @brief Color matrix from the white balanced camera RGB to the working RGB
+   * @param[in] matrix - row major 3x3 matrix
+   */
+  void setMatrix(const std::array<float, 9> &matrix);
+
+  /**
+   * @brief Global Reinhard tone mapping of the corrected radiance, with a white point
+   *   Lm = key * 2^exposure / logAverage * L
+   *   Ld = Lm * (1 + Lm / whitePoint^2) / (1 + Lm)
+   * The RGB channels are scaled by Ld / L, L is the Rec.709 luminance.
+   * @param[in] exposure - stops added to the 0.18 key
+   * @param[in] whitePoint - smallest scaled luminance Lm mapped to 1
+   */
+  void setToneMap(float exposure, float whitePoint);
+
+  /**
+   * @brief Log-average luminance of the corrected radiance at the target time, from the pre-pass of the merge
+   * Measured on the full sources, the tiles of a frame share the same tone mapping.
+   * @param[in] logAverage
+   */
+  void setLogAverage(float logAverage);
+
+  /**
+   * @brief Write the corrected radiance, without tone mapping
+   */
+  void disableToneMap()
+  {
+    _toneMapped = false;
+  }
+
+  bool isToneMapped() const
+  {
+    return _toneMapped;
+  }
+
+  /**
+   * @brief The stage doesn't change the radiance
+   */
+  bool isIdentity() const
+  {
+    return (_flatField == nullptr) && _identityColor && !_toneMapped;
+  }
+
+  bool hasFlatField() const
+  {
+    return _flatField != nullptr;
+  }
+
+  /**
+   * @brief White balance folded in the color matrix, row major
+   */
+  const std::array<float, 9>& getColorMatrix() const
+  {
+    return _colorMatrix;
+  }
+
+  /**
+   * @brief Correct a single RGB pixel in place without the tone mapping, for the log-average pre-pass
+   * @param[in,out] pixel - RGB radiance
+   * @param[in] x - pixel coordinates
+   * @param[in] y
+   */
+  void applyPixel(float *pixel, int x, int y) const;
+
+  /**
+   * @brief Correct a row of RGB(A) pixels in place, other channels (alpha) are kept
+   * @param[in,out] row - first pixel of the row
+   * @param[in] nbChannels - number of channels of the row pixels
+   * @param[in] width - number of pixels
+   * @param[in] x - pixel coordinates of the first pixel
+   * @param[in] y
+   */
+  void applyRow(float *row, std::size_t nbChannels, std::size_t width, int x, int y) const;
+
+private:
+
+  /**
+   * @brief Fold the white balance in the color matrix
+   */
+  void update();
+
+  /**
+   * @brief Scale of the luminance from the key, the exposure and the log-average
+   */
+  void updateToneMap();
+
+  const Image<float> *_flatField = nullptr;
+  std::array<float, 3> _whiteBalance;
+  std::array<float, 9> _matrix;
+  std::array<float, 9> _colorMatrix; //matrix * diag(whiteBalance)
+  bool _identityColor = true;
+  bool _toneMapped = false;
+  float _exposure = 0.f;
+  float _logAverage = 1.f;
+  float _toneScale = 0.18f; //key * 2^exposure / logAverage
+  float _inverseWhite2 = 0.f; //1 / whitePoint^2
+};
+
+} // namespace common
+} // namespace cameraColorCalibration
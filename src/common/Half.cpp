@@ -0,0 +1,201 @@
+#include "Half.hpp"
+#include <cstring>
+
+//F16C conversions are compiled with function target attributes and selected at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HDR_HALF_F16C
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+float Half::halfToFloat(std::uint16_t bits)
+{
+  const std::uint32_t sign = static_cast<std::uint32_t>(bits & 0x8000u) << 16;
+  std::uint32_t exponent = (bits >> 10) & 0x1Fu;
+  std::uint32_t mantissa = bits & 0x3FFu;
+  std::uint32_t result;
+
+  if(exponent == 0x1Fu)
+  {
+    //infinity or NaN
+    result = sign | 0x7F800000u | (mantissa << 13);
+  }
+  else if(exponent == 0)
+  {
+    if(mantissa == 0)
+    {
+      result = sign;
+    }
+    else
+    {
+      //subnormal half, normal float
+      exponent = 127 - 15 + 1;
+      while((mantissa & 0x400u) == 0)
+      {
+        mantissa <<= 1;
+        --exponent;
+      }
+      result = sign | (exponent << 23) | ((mantissa & 0x3FFu) << 13);
+    }
+  }
+  else
+  {
+    result = sign | ((exponent + 127 - 15) << 23) | (mantissa << 13);
+  }
+
+  float value;
+  std::memcpy(&value, &result, sizeof(value));
+  return value;
+}
+
+std::uint16_t Half::floatToHalf(float value)
+{
+  std::uint32_t bits;
+  std::memcpy(&bits, &value, sizeof(bits));
+
+  const std::uint16_t sign = static_cast<std::uint16_t>((bits >> 16) & 0x8000u);
+  const std::uint32_t absolute = bits & 0x7FFFFFFFu;
+
+  if(absolute >= 0x7F800000u)
+  {
+    //infinity or NaN, NaN stays a quiet NaN
+    return sign | 0x7C00u | ((absolute > 0x7F800000u) ? 0x200u : 0u);
+  }
+
+  if(absolute >= 0x477FF000u)
+  {
+    //rounds over the largest half (65504)
+    return sign | 0x7C00u;
+  }
+
+  if(absolute < 0x38800000u)
+  {
+    //subnormal half (under 2^-14), zero under 2^-25
+    if(absolute < 0x33000000u)
+    {
+      return sign;
+    }
+    const std::uint32_t exponent = absolute >> 23;
+    const std::uint32_t mantissa = (absolute & 0x7FFFFFu) | 0x800000u;
+    const std::uint32_t shift = 126 - exponent;
+    std::uint32_t result = mantissa >> shift;
+    const std::uint32_t remainder = mantissa & ((1u << shift) - 1);
+    const std::uint32_t halfway = 1u << (shift - 1);
+    if((remainder > halfway) || ((remainder == halfway) && (result & 1u)))
+    {
+      ++result;
+    }
+    return sign | static_cast<std::uint16_t>(result);
+  }
+
+  //rebias the exponent, a rounding carry goes to the exponent
+  std::uint32_t result = (absolute - 0x38000000u) >> 13;
+  const std::uint32_t remainder = absolute & 0x1FFFu;
+  if((remainder > 0x1000u) || ((remainder == 0x1000u) && (result & 1u)))
+  {
+    ++result;
+  }
+  return sign | static_cast<std::uint16_t>(result);
+}
+
+#ifdef HDR_HALF_F16C
+
+__attribute__((target("avx,f16c")))
+static void convertHalfToFloatF16c(const Half *source, float *destination, std::size_t size)
+{
+  std::size_t i = 0;
+  for(; i + 8 <= size; i += 8)
+  {
+    const __m128i halfs = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i));
+    _mm256_storeu_ps(destination + i, _mm256_cvtph_ps(halfs));
+  }
+  for(; i < size; ++i)
+  {
+    destination[i] = source[i];
+  }
+}
+
+__attribute__((target("avx,f16c")))
+static void convertFloatToHalfF16c(const float *source, Half *destination, std::size_t size)
+{
+  std::size_t i = 0;
+  for(; i + 8 <= size; i += 8)
+  {
+    const __m128i halfs = _mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(destination + i), halfs);
+  }
+  for(; i < size; ++i)
+  {
+    destination[i] = source[i];
+  }
+}
+
+/**
+ * @brief Check once if the running CPU has the F16C instructions
+ * Reads CPUID leaf 1 directly, __builtin_cpu_supports("f16c") is rejected by older compilers.
+ * The 256 bits conversions also need the OS to save the AVX registers.
+ */
+static bool hasF16c()
+{
+  static const bool supported = []()
+  {
+    unsigned int eax, ebx, ecx, edx;
+    if(!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+    {
+      return false;
+    }
+    
+    const unsigned int osxsave = 1u << 27;
+    const unsigned int avx = 1u << 28;
+    const unsigned int f16c = 1u << 29;
+    if((ecx & (osxsave | avx | f16c)) != (osxsave | avx | f16c))
+    {
+      return false;
+    }
+    
+    //XCR0: SSE and AVX states enabled by the OS
+    unsigned int xcr0Low, xcr0High;
+    __asm__ __volatile__("xgetbv" : "=a"(xcr0Low), "=d"(xcr0High) : "c"(0));
+    return (xcr0Low & 0x6u) == 0x6u;
+  }();
+  return supported;
+}
+
+#endif
+
+void convertHalfToFloat(const Half *source, float *destination, std::size_t size)
+{
+#ifdef HDR_HALF_F16C
+  if(hasF16c())
+  {
+    convertHalfToFloatF16c(source, destination, size);
+    return;
+  }
+#endif
+  for(std::size_t i = 0; i < size; ++i)
+  {
+    destination[i] = source[i];
+  }
+}
+
+void convertFloatToHalf(const float *source, Half *destination, std::size_t size)
+{
+#ifdef HDR_HALF_F16C
+  if(hasF16c())
+  {
+    convertFloatToHalfF16c(source, destination, size);
+    return;
+  }
+#endif
+  for(std::size_t i = 0; i < size; ++i)
+  {
+    destination[i] = source[i];
+  }
+}
+
+} // namespace common
+} // namespace cameraColorCalibration
@@ -0,0 +1,76 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+/**
+ * @brief 16 bits floating point sample (IEEE 754 binary16), the OFX half bit depth
+ * Arithmetic goes through float. Buffers are converted with convertHalfToFloat and convertFloatToHalf,
+ * which use the F16C instructions when the CPU has them.
+ */
+class Half
+{
+public:
+
+  Half() = default;
+
+  Half(float value) :
+    _bits(floatToHalf(value))
+  {}
+
+  operator float() const
+  {
+    return halfToFloat(_bits);
+  }
+
+  Half& operator*=(float coefficient)
+  {
+    _bits = floatToHalf(halfToFloat(_bits) * coefficient);
+    return *this;
+  }
+
+  std::uint16_t getBits() const
+  {
+    return _bits;
+  }
+
+  /**
+   * @brief Convert a half sample to float
+   * @param[in] bits - half sample
+   */
+  static float halfToFloat(std::uint16_t bits);
+
+  /**
+   * @brief Convert a float to a half sample, rounded to the nearest even
+   * Values over the half range are infinite.
+   * @param[in] value
+   */
+  static std::uint16_t floatToHalf(float value);
+
+private:
+  std::uint16_t _bits = 0;
+};
+
+static_assert(sizeof(Half) == 2, "Half has to match the OFX half sample size");
+
+/**
+ * @brief Convert a buffer of half samples to float
+ * @param[in] source
+ * @param[out] destination
+ * @param[in] size - number of samples
+ */
+void convertHalfToFloat(const Half *source, float *destination, std::size_t size);
+
+/**
+ * @brief Convert a buffer of float samples to half
+ * @param[in] source
+ * @param[out] destination
+ * @param[in] size - number of samples
+ */
+void convertFloatToHalf(const float *source, Half *destination, std::size_t size);
+
+} // namespace common
+} // namespace cameraColorCalibration
@@ -0,0 +1,83 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+/**
+ * @brief 64 bits FNV-1a hash of contents, for cache keys
+ */
+class Hash
+{
+public:
+
+  /**
+   * @brief Add raw bytes to the hash
+   * @param[in] data
+   * @param[in] size - number of bytes
+   */
+  void add(const void *data, std::size_t size)
+  {
+    const unsigned char *bytes = static_cast<const unsigned char*>(data);
+    for(std::size_t i = 0; i < size; ++i)
+    {
+      _value ^= bytes[i];
+      _value *= prime;
+    }
+  }
+
+  template<typename T>
+  void add(const std::vector<T> &values)
+  {
+    add(values.size());
+    add(values.data(), values.size() * sizeof(T));
+  }
+
+  void add(const std::string &value)
+  {
+    add(value.size());
+    add(value.data(), value.size());
+  }
+
+  void add(const std::vector<std::string> &values)
+  {
+    add(values.size());
+    for(auto const &value : values)
+    {
+      add(value);
+    }
+  }
+
+  void add(std::size_t value)
+  {
+    add(&value, sizeof(value));
+  }
+
+  void add(int value)
+  {
+    add(&value, sizeof(value));
+  }
+
+  void add(float value)
+  {
+    add(&value, sizeof(value));
+  }
+
+  std::uint64_t getValue() const
+  {
+    return _value;
+  }
+
+private:
+  static constexpr std::uint64_t offsetBasis = 14695981039346656037ULL;
+  static constexpr std::uint64_t prime = 1099511628211ULL;
+
+  std::uint64_t _value = offsetBasis;
+};
+
+} // namespace common
+} // namespace cameraColorCalibration
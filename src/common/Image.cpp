@@ -1,6 +1,11 @@
 #include "Image.hpp"
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <iostream>
+#include <limits>
+#include <type_traits>
+#include <utility>
 
 
 namespace cameraColorCalibration {
@@ -55,8 +60,10 @@ Image<DataType>::~Image()
 template<typename DataType>
 void Image<DataType>::setOfxImage(OFX::Image *imgData)
 {
-  std::size_t width = imgData->getRegionOfDefinition().x2 - imgData->getRegionOfDefinition().x1;
-  std::size_t height = imgData->getRegionOfDefinition().y2 - imgData->getRegionOfDefinition().y1;
+  //pixel data covers the image bounds, not always the region of definition (tiles)
+  const OfxRectI bounds = imgData->getBounds();
+  std::size_t width = bounds.x2 - bounds.x1;
+  std::size_t height = bounds.y2 - bounds.y1;
   
   //assert(width > 0);
   //assert(height > 0);
@@ -65,6 +72,8 @@ void Image<DataType>::setOfxImage(OFX::Image *imgData)
   _imgPtr = imgData;
  
   setExternalBuffer((DataType*)imgData->getPixelData(), width, height, imgData->getPixelComponentCount(), imgData->getRowBytes() / sizeof(DataType));
+  _x1 = bounds.x1;
+  _y1 = bounds.y1;
 }
 
 template<typename DataType>
@@ -97,6 +106,22 @@ void Image<DataType>::setExternalBuffer(DataType *data, std::size_t width, std::
   _rowBufferSize = rowBufferSize;
 }
 
+template<typename DataType>
+void Image<DataType>::setView(const Image &other, const OfxRectI &window)
+{
+  assert(window.x1 >= other._x1 && window.x2 <= other._x1 + static_cast<int>(other._width));
+  assert(window.y1 >= other._y1 && window.y2 <= other._y1 + static_cast<int>(other._height));
+  
+  setExternalBuffer(other.getPixel(window.x1 - other._x1, window.y1 - other._y1), 
+                    window.x2 - window.x1, 
+                    window.y2 - window.y1, 
+                    other._nbChannels, 
+                    other._rowBufferSize);
+  _x1 = window.x1;
+  _y1 = window.y1;
+  _cfaPattern = other._cfaPattern;
+}
+
 template<typename DataType>
 void Image<DataType>::clear()
 {
@@ -110,6 +135,9 @@ void Image<DataType>::clear()
   _height = 0;
   _size = 0;
   _nbPixels = 0;
+  _x1 = 0;
+  _y1 = 0;
+  _cfaPattern = eCfaNone;
 }
 
 template<typename DataType>
@@ -230,8 +258,6 @@ void Image<DataType>::copyFrom(const Image &other)
   assert(this->getWidth() == other.getWidth());
   assert(this->getNbChannels() >= other.getNbChannels());
   
-  this->setZero();
-  
   for(std::size_t y = 0; y < getHeight(); ++y)
   {
     for(std::size_t x = 0; x < getWidth(); ++x)
@@ -246,10 +272,135 @@ void Image<DataType>::copyFrom(const Image &other)
         ++ptr;
         ++otherPtr;
       }
+      
+      //channels missing in the other image are set to zero
+      for(std::size_t channel = other.getNbChannels(); channel < getNbChannels(); ++channel)
+      {
+        *ptr = 0;
+        
+        ++ptr;
+      }
     }
   }
 }
 
+template<typename DataType>
+template<typename OtherType>
+void Image<DataType>::convertFrom(const Image<OtherType> &other)
+{
+  createInternalBuffer(other.getWidth(), other.getHeight(), other.getNbChannels());
+  setOrigin(other.getBounds().x1, other.getBounds().y1);
+  setCfaPattern(other.getCfaPattern());
+  
+  for(std::size_t y = 0; y < getHeight(); ++y)
+  {
+    DataType *ptr = getPixel(0, y);
+    const OtherType *otherPtr = other.getPixel(0, y);
+    
+    for(std::size_t i = 0; i < getWidth() * getNbChannels(); ++i)
+    {
+      ptr[i] = static_cast<DataType>(getNormalizedValue(otherPtr[i]));
+    }
+  }
+}
+
+/**
+ * @brief Range of high resolution pixels [begin, end) whose center falls in a low resolution pixel
+ * @param[in] index - low resolution pixel
+ * @param[in] scale - resolution ratio
+ * @param[in] first - first high resolution pixel
+ * @param[in] last - pixel after the last high resolution pixel
+ */
+static std::pair<int, int> getFootprint(int index, double scale, int first, int last)
+{
+  const int begin = static_cast<int>(std::ceil(index / scale - 0.5));
+  const int end = static_cast<int>(std::ceil((index + 1) / scale - 0.5));
+  return std::make_pair(std::max(begin, first), std::max(std::max(begin, first), std::min(end, last)));
+}
+
+template<typename DataType>
+void Image<DataType>::downsampleFrom(const Image &other, double scaleX, double scaleY)
+{
+  assert(scaleX > 0.0 && scaleX <= 1.0);
+  assert(scaleY > 0.0 && scaleY <= 1.0);
+  
+  if(other.getCfaPattern() != eCfaNone)
+  {
+    //a box filter would mix the colors of the mosaic
+    throw std::logic_error("Can't downsample a Bayer mosaic");
+  }
+  
+  const OfxRectI bounds = other.getBounds();
+  const int x1 = static_cast<int>(std::floor(bounds.x1 * scaleX));
+  const int y1 = static_cast<int>(std::floor(bounds.y1 * scaleY));
+  const int x2 = static_cast<int>(std::ceil(bounds.x2 * scaleX));
+  const int y2 = static_cast<int>(std::ceil(bounds.y2 * scaleY));
+  
+  createInternalBuffer(x2 - x1, y2 - y1, other.getNbChannels());
+  setOrigin(x1, y1);
+  
+  //column footprints are the same for all the rows
+  std::vector< std::pair<int, int> > columns(getWidth());
+  for(std::size_t x = 0; x < getWidth(); ++x)
+  {
+    columns[x] = getFootprint(x1 + static_cast<int>(x), scaleX, bounds.x1, bounds.x2);
+  }
+  
+  std::vector<double> sum(getNbChannels());
+  
+  for(std::size_t y = 0; y < getHeight(); ++y)
+  {
+    const std::pair<int, int> rows = getFootprint(y1 + static_cast<int>(y), scaleY, bounds.y1, bounds.y2);
+    DataType *ptr = getPixel(0, y);
+    
+    for(std::size_t x = 0; x < getWidth(); ++x)
+    {
+      std::fill(sum.begin(), sum.end(), 0.0);
+      
+      for(int sy = rows.first; sy < rows.second; ++sy)
+      {
+        for(int sx = columns[x].first; sx < columns[x].second; ++sx)
+        {
+          const DataType *otherPtr = other.getPixel(sx - bounds.x1, sy - bounds.y1);
+          for(std::size_t channel = 0; channel < getNbChannels(); ++channel)
+          {
+            sum[channel] += otherPtr[channel];
+          }
+        }
+      }
+      
+      //pixels on the border may have an empty footprint
+      const int count = (rows.second - rows.first) * (columns[x].second - columns[x].first);
+      const double coefficient = (count > 0) ? 1.0 / count : 0.0;
+      //integer codes are rounded to the nearest code
+      const double rounding = std::is_integral<DataType>::value ? 0.5 : 0.0;
+      for(std::size_t channel = 0; channel < getNbChannels(); ++channel)
+      {
+        *ptr = static_cast<DataType>(sum[channel] * coefficient + rounding);
+        ++ptr;
+      }
+    }
+  }
+}
+
+template<typename DataType>
+void Image<DataType>::swap(Image &other)
+{
+  std::swap(_imgPtr, other._imgPtr);
+  std::swap(_data, other._data);
+  std::swap(_hasOwnership, other._hasOwnership);
+  std::swap(_width, other._width);
+  std::swap(_height, other._height);
+  std::swap(_nbChannels, other._nbChannels);
+  std::swap(_size, other._size);
+  std::swap(_nbPixels, other._nbPixels);
+  std::swap(_rowBufferSize, other._rowBufferSize);
+  std::swap(_channelQuantization, other._channelQuantization);
+  std::swap(_x1, other._x1);
+  std::swap(_y1, other._y1);
+  std::swap(_cfaPattern, other._cfaPattern);
+}
+
 template<typename DataType>
 void Image<DataType>::checkSameDimensions(const std::vector< Image<DataType> > &images)
 {
@@ -268,6 +419,14 @@ void Image<DataType>::checkSameDimensions(const std::vector< Image<DataType> > &
 }
 
 template class Image<float>;
+template class Image<std::uint8_t>;
+template class Image<std::uint16_t>;
+template class Image<Half>;
+
+template void Image<float>::convertFrom(const Image<float> &other);
+template void Image<float>::convertFrom(const Image<std::uint8_t> &other);
+template void Image<float>::convertFrom(const Image<std::uint16_t> &other);
+template void Image<float>::convertFrom(const Image<Half> &other);
 
 } // namespace common
 } // namespace cameraColorCalibration
\ No newline at end of file
@@ -1,13 +1,27 @@
 #pragma once
 #include "ofxsImageEffect.h"
 #include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <type_traits>
 #include <vector>
+#include "Cfa.hpp"
+#include "Half.hpp"
 #include "rgbCurve.hpp"
 
 
 namespace cameraColorCalibration {
 namespace common {
 
+/**
+ * @brief Normalized value of a sample, integer codes are divided by their maximum code
+ */
+template<typename DataType>
+inline float getNormalizedValue(DataType value)
+{
+  return std::is_integral<DataType>::value ? static_cast<float>(value) / static_cast<float>(std::numeric_limits<DataType>::max()) : static_cast<float>(value);
+}
+
 template<typename DataType>
 class Image
 {
@@ -66,6 +80,13 @@ public:
    */
   void setExternalBuffer(DataType *data, std::size_t width, std::size_t height, std::size_t channels, std::size_t rowBufferSize);
 
+  /**
+   * @brief Reset image as a view on a region of another image, without copy
+   * @param[in] other
+   * @param[in] window - region in pixel coordinates, inside other bounds
+   */
+  void setView(const Image &other, const OfxRectI &window);
+
   /**
    * @brief Clean image memory
    * Reset all member variables
@@ -107,6 +128,29 @@ public:
    */
   void copyFrom(const Image &other);
 
+  /**
+   * @brief Reset image as a copy of an image of another data type
+   * Integer codes are normalized to [0, 1], half samples keep their value, the origin is kept.
+   * @param[in] other
+   */
+  template<typename OtherType>
+  void convertFrom(const Image<OtherType> &other);
+
+  /**
+   * @brief Reset image as a box filtered copy of another image at a lower resolution
+   * Each pixel is the average of the other image pixels whose center falls in its footprint.
+   * @param[in] other - image at the higher resolution
+   * @param[in] scaleX - horizontal resolution ratio, in ]0, 1]
+   * @param[in] scaleY - vertical resolution ratio, in ]0, 1]
+   */
+  void downsampleFrom(const Image &other, double scaleX, double scaleY);
+
+  /**
+   * @brief Exchange buffers and dimensions with another image, without copy
+   * @param other
+   */
+  void swap(Image &other);
+
   
   bool isEmpty() const
   {
@@ -173,6 +217,58 @@ public:
     return _channelQuantization;
   }
 
+  /**
+   * @brief Pixel coordinates of the image buffer
+   */
+  OfxRectI getBounds() const
+  {
+    OfxRectI bounds;
+    bounds.x1 = _x1;
+    bounds.y1 = _y1;
+    bounds.x2 = _x1 + static_cast<int>(_width);
+    bounds.y2 = _y1 + static_cast<int>(_height);
+    return bounds;
+  }
+
+  /**
+   * @brief Set the pixel coordinates of the first pixel
+   * @param[in] x1
+   * @param[in] y1
+   */
+  void setOrigin(int x1, int y1)
+  {
+    _x1 = x1;
+    _y1 = y1;
+  }
+
+  /**
+   * @brief Bayer pattern of a single channel mosaic, eCfaNone for an image with all the channels
+   */
+  ECfaPattern getCfaPattern() const
+  {
+    return _cfaPattern;
+  }
+
+  /**
+   * @brief Set the Bayer pattern of a single channel mosaic
+   * The pattern cell starts at the pixel coordinates (0, 0), not at the first pixel.
+   * @param[in] pattern
+   */
+  void setCfaPattern(ECfaPattern pattern)
+  {
+    _cfaPattern = pattern;
+  }
+
+  /**
+   * @brief Color of a mosaic sample
+   * @param[in] x - buffer column
+   * @param[in] y - buffer row
+   */
+  std::size_t getCfaColor(std::size_t x, std::size_t y) const
+  {
+    return common::getCfaColor(_cfaPattern, _x1 + static_cast<int>(x), _y1 + static_cast<int>(y));
+  }
+
   /**
    * @brief Check if a group of images have the same dimensions
    * @param[in] images
@@ -190,6 +286,9 @@ private:
   std::size_t _nbPixels = 0;
   std::size_t _rowBufferSize = 0;
   std::size_t _channelQuantization = 1 << 12;
+  int _x1 = 0; //pixel coordinates of the first pixel
+  int _y1 = 0;
+  ECfaPattern _cfaPattern = eCfaNone;
 };
 
 } // namespace common
@@ -0,0 +1,101 @@
+#include "MergeAccumulator.hpp"
+#include <cassert>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+void MergeAccumulator::init(std::size_t width, std::size_t height, const std::vector<float> &times)
+{
+  _times = times;
+  _wsum.createInternalBuffer(width, height, 3);
+  _wdiv.createInternalBuffer(width, height, 3);
+  _wsum.setZero();
+  _wdiv.setZero();
+
+  _planes = std::vector< Image<float> >(times.size());
+  for(auto &plane : _planes)
+  {
+    plane.createInternalBuffer(width, height, 3);
+    plane.setZero();
+  }
+}
+
+template<typename SourceType>
+void MergeAccumulator::accumulateRows(const RobertsonMerge &merge,
+                                      const std::vector< Image<SourceType> > &images,
+                                      std::size_t yBegin,
+                                      std::size_t yEnd)
+{
+  //checks
+  assert(images.size() == _planes.size());
+  assert(yEnd <= _wsum.getHeight());
+
+  const std::size_t rowSize = _wsum.getWidth() * 3;
+
+  for(std::size_t i = 0; i < images.size(); ++i)
+  {
+    //the plane gets the weighted radiances of the exposure, the weights go straight to wdiv
+    merge.accumulateRows(images[i], i, _planes[i], _wdiv, yBegin, yEnd);
+
+    for(std::size_t y = yBegin; y < yEnd; ++y)
+    {
+      const float *ptrPlane = _planes[i].getPixel(0, y);
+      float *ptrWsum = _wsum.getPixel(0, y);
+
+      for(std::size_t x = 0; x < rowSize; ++x)
+      {
+        ptrWsum[x] += ptrPlane[x];
+      }
+    }
+  }
+}
+
+void MergeAccumulator::updateTimeRows(std::size_t exposure, float time, std::size_t yBegin, std::size_t yEnd)
+{
+  //checks
+  assert(exposure < _planes.size());
+  assert(time > 0.0f);
+  assert(yEnd <= _wsum.getHeight());
+
+  //planes hold w * r / t
+  const float ratio = _times[exposure] / time;
+  const std::size_t rowSize = _wsum.getWidth() * 3;
+
+  for(std::size_t y = yBegin; y < yEnd; ++y)
+  {
+    float *ptrPlane = _planes[exposure].getPixel(0, y);
+    float *ptrWsum = _wsum.getPixel(0, y);
+
+    for(std::size_t x = 0; x < rowSize; ++x)
+    {
+      const float value = ptrPlane[x] * ratio;
+      ptrWsum[x] += value - ptrPlane[x];
+      ptrPlane[x] = value;
+    }
+  }
+}
+
+void MergeAccumulator::swap(MergeAccumulator &other)
+{
+  _planes.swap(other._planes);
+  _wsum.swap(other._wsum);
+  _wdiv.swap(other._wdiv);
+  _times.swap(other._times);
+}
+
+void MergeAccumulator::clear()
+{
+  _planes.clear();
+  _wsum.clear();
+  _wdiv.clear();
+  _times.clear();
+}
+
+template void MergeAccumulator::accumulateRows(const RobertsonMerge &, const std::vector< Image<float> > &, std::size_t, std::size_t);
+template void MergeAccumulator::accumulateRows(const RobertsonMerge &, const std::vector< Image<std::uint8_t> > &, std::size_t, std::size_t);
+template void MergeAccumulator::accumulateRows(const RobertsonMerge &, const std::vector< Image<std::uint16_t> > &, std::size_t, std::size_t);
+template void MergeAccumulator::accumulateRows(const RobertsonMerge &, const std::vector< Image<Half> > &, std::size_t, std::size_t);
+
+} // namespace common
+} // namespace cameraColorCalibration
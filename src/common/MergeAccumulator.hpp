@@ -0,0 +1,122 @@
+#pragma once
+#include "Image.hpp"
+#include "RobertsonMerge.hpp"
+#include <vector>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+/**
+ * @brief Robertson merge accumulators keeping the contribution plane of each exposure
+ * A change of one exposure time only rescales the plane of this exposure in the weighted
+ * radiance sum, the weight sum doesn't depend on the exposure times.
+ * Memory holds one RGB plane per exposure plus the two accumulators.
+ */
+class MergeAccumulator
+{
+public:
+
+  /**
+   * @brief Allocate and zero the accumulators
+   * @param[in] width
+   * @param[in] height
+   * @param[in] times - exposure time of each image
+   */
+  void init(std::size_t width, std::size_t height, const std::vector<float> &times);
+
+  /**
+   * @brief Accumulate a band of rows of all the exposures
+   * @param[in] merge - merge operator initialized with the same times
+   * @param[in] images - source images
+   * @param[in] yBegin - first row
+   * @param[in] yEnd - row after the last row
+   */
+  template<typename SourceType>
+  void accumulateRows(const RobertsonMerge &merge,
+                      const std::vector< Image<SourceType> > &images,
+                      std::size_t yBegin,
+                      std::size_t yEnd);
+
+  /**
+   * @brief Move the contribution of one exposure to a new exposure time on a band of rows
+   * setTime has to be called once all the rows are updated.
+   * @param[in] exposure - index of the exposure
+   * @param[in] time - new exposure time
+   * @param[in] yBegin - first row
+   * @param[in] yEnd - row after the last row
+   */
+  void updateTimeRows(std::size_t exposure, float time, std::size_t yBegin, std::size_t yEnd);
+
+  /**
+   * @brief Compute the radiance of a band of rows
+   * @param[out] radiance
+   * @param[in] targetTime
+   * @param[in] yBegin - first row
+   * @param[in] yEnd - row after the last row
+   */
+  void finalizeRows(Image<float> &radiance, float targetTime, std::size_t yBegin, std::size_t yEnd) const
+  {
+    RobertsonMerge::finalizeRows(_wsum, _wdiv, radiance, targetTime, yBegin, yEnd);
+  }
+
+  /**
+   * @brief Exchange accumulators with another instance, without copy
+   * @param other
+   */
+  void swap(MergeAccumulator &other);
+
+  /**
+   * @brief Release all buffers
+   */
+  void clear();
+
+  void setTime(std::size_t exposure, float time)
+  {
+    assert(exposure < _times.size());
+    _times[exposure] = time;
+  }
+
+  const std::vector<float>& getTimes() const
+  {
+    return _times;
+  }
+
+  std::size_t getHeight() const
+  {
+    return _wsum.getHeight();
+  }
+
+  bool isEmpty() const
+  {
+    return _planes.empty();
+  }
+
+  /**
+   * @brief Memory of the planes and the accumulators
+   */
+  std::size_t getByteSize() const
+  {
+    return (_planes.size() + 2) * _wsum.getSize() * sizeof(float);
+  }
+
+  /**
+   * @brief Memory of the accumulators of a merge, before init
+   * @param[in] width
+   * @param[in] height
+   * @param[in] nbExposures
+   */
+  static std::size_t getByteSize(std::size_t width, std::size_t height, std::size_t nbExposures)
+  {
+    return (nbExposures + 2) * width * height * 3 * sizeof(float);
+  }
+
+private:
+  std::vector< Image<float> > _planes; //weighted radiance of each exposure
+  Image<float> _wsum;
+  Image<float> _wdiv;
+  std::vector<float> _times;
+};
+
+} // namespace common
+} // namespace cameraColorCalibration
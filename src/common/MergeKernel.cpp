@@ -0,0 +1,1310 @@
+#include "MergeKernel.hpp"
+#include "Image.hpp"
+#include <algorithm>
+#include <cassert>
+#include <limits>
+#include <vector>
+
+//SIMD kernels are compiled with function target attributes and selected at runtime
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define HDR_MERGE_X86_KERNELS
+#include <immintrin.h>
+#endif
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+//exposures of the usual brackets, the per call arrays of the row kernels stay on the stack
+static const std::size_t kStackExposures = 16;
+
+/**
+ * @brief Per call array of a row kernel, on the stack up to stackSize elements, on the heap above
+ * Row functions run once per row, a heap allocation would cost as much as the merge of a short row.
+ */
+template<typename T, std::size_t stackSize>
+class RowArray
+{
+public:
+
+  explicit RowArray(std::size_t size)
+  {
+    if(size > stackSize)
+    {
+      _heap.resize(size);
+      _data = _heap.data();
+    }
+  }
+
+  RowArray(const RowArray &other) = delete;
+  RowArray& operator=(const RowArray &other) = delete;
+
+  T& operator[](std::size_t index)
+  {
+    return _data[index];
+  }
+
+  T* data()
+  {
+    return _data;
+  }
+
+private:
+
+  T _stack[stackSize];
+  std::vector<T> _heap;
+  T *_data = _stack;
+};
+
+void mergeRowScalar(const MergeLut &lut,
+                    const float * const *sources,
+                    std::size_t srcChannels,
+                    std::size_t width,
+                    float *radiance,
+                    std::size_t dstChannels,
+                    float targetTime)
+{
+  const std::size_t nbImages = lut.getNbExposures();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+
+  for(std::size_t x = 0; x < width; ++x)
+  {
+    //for each pixels
+    float *ptrRadiance = radiance + x * dstChannels;
+
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      double wsum = 0.0;
+      double wdiv = 0.0;
+
+      for(std::size_t i = 0; i < nbImages; ++i)
+      {
+        //for each images
+        const std::size_t index = lut.getIndex(sources[i][x * srcChannels + channel]);
+
+        wsum += lut.getWsum(i, channel)[index];
+        wdiv += lut.getWdiv(i, channel)[index];
+      }
+
+      if(wdiv > 0.0001f)
+      {
+        *ptrRadiance = (wsum / wdiv) * targetTime;
+      }
+      else
+      {
+        *ptrRadiance = 0.0f;
+      }
+
+      ++ptrRadiance; //next channel
+    }
+  }
+}
+
+/**
+ * @brief Scalar kernel of integer sources, the code value is the table index
+ */
+template<typename SourceType>
+static void mergeRowCodes(const MergeLut &lut,
+                          const SourceType * const *sources,
+                          std::size_t srcChannels,
+                          std::size_t width,
+                          float *radiance,
+                          std::size_t dstChannels,
+                          float targetTime)
+{
+  assert(lut.getNbCodes() == getNbCodes<SourceType>());
+
+  const std::size_t nbImages = lut.getNbExposures();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+
+  for(std::size_t x = 0; x < width; ++x)
+  {
+    //for each pixels
+    float *ptrRadiance = radiance + x * dstChannels;
+
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      double wsum = 0.0;
+      double wdiv = 0.0;
+
+      for(std::size_t i = 0; i < nbImages; ++i)
+      {
+        //for each images
+        const std::size_t code = sources[i][x * srcChannels + channel];
+
+        wsum += lut.getWsum(i, channel)[code];
+        wdiv += lut.getWdiv(i, channel)[code];
+      }
+
+      if(wdiv > 0.0001f)
+      {
+        *ptrRadiance = (wsum / wdiv) * targetTime;
+      }
+      else
+      {
+        *ptrRadiance = 0.0f;
+      }
+
+      ++ptrRadiance; //next channel
+    }
+  }
+}
+
+void mergeRowScalar(const MergeLut &lut,
+                    const std::uint8_t * const *sources,
+                    std::size_t srcChannels,
+                    std::size_t width,
+                    float *radiance,
+                    std::size_t dstChannels,
+                    float targetTime)
+{
+  mergeRowCodes(lut, sources, srcChannels, width, radiance, dstChannels, targetTime);
+}
+
+void mergeRowScalar(const MergeLut &lut,
+                    const std::uint16_t * const *sources,
+                    std::size_t srcChannels,
+                    std::size_t width,
+                    float *radiance,
+                    std::size_t dstChannels,
+                    float targetTime)
+{
+  mergeRowCodes(lut, sources, srcChannels, width, radiance, dstChannels, targetTime);
+}
+
+/**
+ * @brief Scalar kernel of 8 bits sources with the fixed point tables, integer accumulation
+ */
+static void mergeRowFixed(const MergeLut &lut,
+                          const std::uint8_t * const *sources,
+                          std::size_t srcChannels,
+                          std::size_t width,
+                          float *radiance,
+                          std::size_t dstChannels,
+                          float targetTime)
+{
+  assert(lut.isFixedPoint());
+
+  const std::size_t nbImages = lut.getNbExposures();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+  const float ratio = lut.getFixedRatio() * targetTime;
+
+  for(std::size_t x = 0; x < width; ++x)
+  {
+    //for each pixels
+    float *ptrRadiance = radiance + x * dstChannels;
+
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      std::int32_t wsum = 0;
+      std::int32_t wdiv = 0;
+
+      for(std::size_t i = 0; i < nbImages; ++i)
+      {
+        const std::uint8_t code = sources[i][x * srcChannels + channel];
+        wsum += lut.getFixedWsum(i, channel)[code];
+        wdiv += lut.getFixedWdiv(i, channel)[code];
+      }
+
+      //same operations as the SIMD kernel, the results are identical
+      if(wdiv > lut.getFixedMinWdiv())
+      {
+        *ptrRadiance = (static_cast<float>(wsum) / static_cast<float>(wdiv)) * ratio;
+      }
+      else
+      {
+        *ptrRadiance = 0.0f;
+      }
+
+      ++ptrRadiance; //next channel
+    }
+  }
+}
+
+/**
+ * @brief Scalar kernel skipping the black and saturated exposures of each sample
+ * Exposures are visited by increasing time, only the exposures from the longest black one
+ * to the shortest saturated one are looked up in the tables.
+ */
+template<typename SourceType>
+static void mergeRowSkip(const MergeLut &lut,
+                         const SourceType * const *sources,
+                         std::size_t srcChannels,
+                         std::size_t width,
+                         float *radiance,
+                         std::size_t dstChannels,
+                         float targetTime)
+{
+  assert(lut.isSkipping());
+
+  const std::vector<std::size_t> &order = lut.getTimeOrder();
+  const std::size_t nbImages = order.size();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+  RowArray<std::size_t, kStackExposures> indexes(nbImages);
+
+  for(std::size_t x = 0; x < width; ++x)
+  {
+    //for each pixels
+    float *ptrRadiance = radiance + x * dstChannels;
+
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      const int blackIndex = lut.getBlackIndex(channel);
+      const int saturatedIndex = lut.getSaturatedIndex(channel);
+      std::size_t first = 0;
+      std::size_t last = nbImages - 1;
+
+      for(std::size_t k = 0; k < nbImages; ++k)
+      {
+        indexes[k] = lut.getIndex(sources[order[k]][x * srcChannels + channel]);
+
+        if(static_cast<int>(indexes[k]) <= blackIndex)
+        {
+          first = k;
+        }
+        if((static_cast<int>(indexes[k]) >= saturatedIndex) && (k < last))
+        {
+          last = k;
+        }
+      }
+      //at least one exposure, even if the samples are not monotonic
+      first = std::min(first, last);
+
+      double wsum = 0.0;
+      double wdiv = 0.0;
+
+      for(std::size_t k = first; k <= last; ++k)
+      {
+        wsum += lut.getWsum(order[k], channel)[indexes[k]];
+        wdiv += lut.getWdiv(order[k], channel)[indexes[k]];
+      }
+
+      if(wdiv > 0.0001f)
+      {
+        *ptrRadiance = (wsum / wdiv) * targetTime;
+      }
+      else
+      {
+        *ptrRadiance = 0.0f;
+      }
+
+      ++ptrRadiance; //next channel
+    }
+  }
+}
+
+/**
+ * @brief Scalar kernel of a linear merge (flat weight and linear response)
+ * The radiance is the mean of the clamped samples divided by their exposure time.
+ */
+template<typename SourceType>
+static void mergeRowLinear(const MergeLut &lut,
+                           const SourceType * const *sources,
+                           std::size_t srcChannels,
+                           std::size_t width,
+                           float *radiance,
+                           std::size_t dstChannels,
+                           float targetTime)
+{
+  assert(lut.isLinear());
+
+  const std::size_t nbImages = lut.getNbExposures();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+  const float *inverseTimes = lut.getInverseTimes();
+  const double scale = targetTime / static_cast<double>(nbImages);
+
+  for(std::size_t x = 0; x < width; ++x)
+  {
+    //for each pixels
+    float *ptrRadiance = radiance + x * dstChannels;
+
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      double sum = 0.0;
+
+      for(std::size_t i = 0; i < nbImages; ++i)
+      {
+        //clamp (NaN goes to 0) as the table index
+        const float value = getNormalizedValue(sources[i][x * srcChannels + channel]);
+        sum += ((value > 0.0f) ? std::min(value, 1.0f) : 0.0f) * inverseTimes[i];
+      }
+
+      *ptrRadiance = sum * scale;
+      ++ptrRadiance; //next channel
+    }
+  }
+}
+
+#ifdef HDR_MERGE_X86_KERNELS
+
+/**
+ * @brief Merge the last pixels of a row (less than a SIMD width) with a scalar row function
+ */
+template<typename SourceType>
+static void mergeRowTail(typename MergeRow<SourceType>::Function tailRow,
+                         const MergeLut &lut,
+                         const SourceType * const *sources,
+                         std::size_t srcChannels,
+                         std::size_t x,
+                         std::size_t width,
+                         float *radiance,
+                         std::size_t dstChannels,
+                         float targetTime)
+{
+  if(x >= width)
+  {
+    return;
+  }
+
+  RowArray<const SourceType*, kStackExposures> tail(lut.getNbExposures());
+  for(std::size_t i = 0; i < lut.getNbExposures(); ++i)
+  {
+    tail[i] = sources[i] + x * srcChannels;
+  }
+  tailRow(lut, tail.data(), srcChannels, width - x, radiance + x * dstChannels, dstChannels, targetTime);
+}
+
+/**
+ * @brief Merge the last pixels of a row (less than a SIMD width) with the scalar kernel
+ */
+static void mergeRowTail(const MergeLut &lut,
+                         const float * const *sources,
+                         std::size_t srcChannels,
+                         std::size_t x,
+                         std::size_t width,
+                         float *radiance,
+                         std::size_t dstChannels,
+                         float targetTime)
+{
+  mergeRowTail<float>(&mergeRowScalar, lut, sources, srcChannels, x, width, radiance, dstChannels, targetTime);
+}
+
+/**
+ * @brief Code values of a channel of 8 pixels
+ * @param[in] src - first pixel
+ * @param[in] srcChannels
+ * @param[in] channel
+ */
+template<typename SourceType>
+__attribute__((target("avx2")))
+static inline __m256i loadCodesAvx2(const SourceType *src, std::size_t srcChannels, std::size_t channel)
+{
+  if((sizeof(SourceType) == 1) && (srcChannels == 4))
+  {
+    //8 bits RGBA pixels are 32 bits lanes, a channel is a shift and a mask
+    const __m256i pixels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+    return _mm256_and_si256(_mm256_srl_epi32(pixels, _mm_cvtsi32_si128(static_cast<int>(8 * channel))), _mm256_set1_epi32(0xFF));
+  }
+
+  if((sizeof(SourceType) == 1) && (srcChannels == 3))
+  {
+    //8 bits RGB pixels are 24 bytes, the channel is shuffled out of two overlapping loads
+    const char c = static_cast<char>(channel);
+    const __m128i first = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i second = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 8));
+    const __m128i firstPixels = _mm_shuffle_epi8(first, _mm_setr_epi8(c, 3 + c, 6 + c, 9 + c, 12 + c, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+    const __m128i lastPixels = _mm_shuffle_epi8(second, _mm_setr_epi8(-1, -1, -1, -1, -1, 7 + c, 10 + c, 13 + c, -1, -1, -1, -1, -1, -1, -1, -1));
+    return _mm256_cvtepu8_epi32(_mm_or_si128(firstPixels, lastPixels));
+  }
+
+  alignas(32) int codes[8];
+  for(std::size_t j = 0; j < 8; ++j)
+  {
+    codes[j] = src[j * srcChannels + channel];
+  }
+  return _mm256_load_si256(reinterpret_cast<const __m256i*>(codes));
+}
+
+/**
+ * @brief AVX2 kernel of integer sources, the codes are gathered table indexes
+ */
+template<typename SourceType, std::size_t kNbExposures>
+__attribute__((target("avx2")))
+static void mergeRowCodesAvx2(const MergeLut &lut,
+                              const SourceType * const *sources,
+                              std::size_t srcChannels,
+                              std::size_t width,
+                              float *radiance,
+                              std::size_t dstChannels,
+                              float targetTime)
+{
+  assert(lut.getNbCodes() == getNbCodes<SourceType>());
+  assert((kNbExposures == 0) || (kNbExposures == lut.getNbExposures()));
+
+  const std::size_t nbImages = (kNbExposures > 0) ? kNbExposures : lut.getNbExposures();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 minWdiv = _mm256_set1_ps(0.0001f);
+  const __m256 target = _mm256_set1_ps(targetTime);
+
+  alignas(32) float values[8];
+
+  std::size_t x = 0;
+  for(; x + 8 <= width; x += 8)
+  {
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      __m256 wsum = zero;
+      __m256 wdiv = zero;
+
+      //fully unrolled for the exposure counts of the common brackets
+#pragma GCC unroll 9
+      for(std::size_t i = 0; i < nbImages; ++i)
+      {
+        const __m256i index = loadCodesAvx2(sources[i] + x * srcChannels, srcChannels, channel);
+
+        wsum = _mm256_add_ps(wsum, _mm256_i32gather_ps(lut.getWsum(i, channel), index, 4));
+        wdiv = _mm256_add_ps(wdiv, _mm256_i32gather_ps(lut.getWdiv(i, channel), index, 4));
+      }
+
+      const __m256 valid = _mm256_cmp_ps(wdiv, minWdiv, _CMP_GT_OQ);
+      _mm256_store_ps(values, _mm256_and_ps(valid, _mm256_mul_ps(_mm256_div_ps(wsum, wdiv), target)));
+
+      for(std::size_t j = 0; j < 8; ++j)
+      {
+        radiance[(x + j) * dstChannels + channel] = values[j];
+      }
+    }
+  }
+  mergeRowTail<SourceType>(&mergeRowCodes<SourceType>, lut, sources, srcChannels, x, width, radiance, dstChannels, targetTime);
+}
+
+/**
+ * @brief AVX2 kernel of 8 bits sources with the fixed point tables, integer gathers and accumulators
+ */
+template<std::size_t kNbExposures>
+__attribute__((target("avx2")))
+static void mergeRowFixedAvx2(const MergeLut &lut,
+                              const std::uint8_t * const *sources,
+                              std::size_t srcChannels,
+                              std::size_t width,
+                              float *radiance,
+                              std::size_t dstChannels,
+                              float targetTime)
+{
+  assert(lut.isFixedPoint());
+  assert((kNbExposures == 0) || (kNbExposures == lut.getNbExposures()));
+
+  const std::size_t nbImages = (kNbExposures > 0) ? kNbExposures : lut.getNbExposures();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+
+  const __m256i zero = _mm256_setzero_si256();
+  const __m256i minWdiv = _mm256_set1_epi32(lut.getFixedMinWdiv());
+  const __m256 ratio = _mm256_set1_ps(lut.getFixedRatio() * targetTime);
+
+  alignas(32) float values[8];
+
+  std::size_t x = 0;
+  for(; x + 8 <= width; x += 8)
+  {
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      __m256i wsum = zero;
+      __m256i wdiv = zero;
+
+      //fully unrolled for the exposure counts of the common brackets
+#pragma GCC unroll 9
+      for(std::size_t i = 0; i < nbImages; ++i)
+      {
+        const __m256i index = loadCodesAvx2(sources[i] + x * srcChannels, srcChannels, channel);
+
+        wsum = _mm256_add_epi32(wsum, _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut.getFixedWsum(i, channel)), index, 4));
+        wdiv = _mm256_add_epi32(wdiv, _mm256_i32gather_epi32(reinterpret_cast<const int*>(lut.getFixedWdiv(i, channel)), index, 4));
+      }
+
+      const __m256 valid = _mm256_castsi256_ps(_mm256_cmpgt_epi32(wdiv, minWdiv));
+      const __m256 result = _mm256_mul_ps(_mm256_div_ps(_mm256_cvtepi32_ps(wsum), _mm256_cvtepi32_ps(wdiv)), ratio);
+      _mm256_store_ps(values, _mm256_and_ps(valid, result));
+
+      for(std::size_t j = 0; j < 8; ++j)
+      {
+        radiance[(x + j) * dstChannels + channel] = values[j];
+      }
+    }
+  }
+  mergeRowTail<std::uint8_t>(&mergeRowFixed, lut, sources, srcChannels, x, width, radiance, dstChannels, targetTime);
+}
+
+__attribute__((target("sse4.2")))
+static void mergeRowSse42(const MergeLut &lut,
+                          const float * const *sources,
+                          std::size_t srcChannels,
+                          std::size_t width,
+                          float *radiance,
+                          std::size_t dstChannels,
+                          float targetTime)
+{
+  const std::size_t nbImages = lut.getNbExposures();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one = _mm_set1_ps(1.0f);
+  const __m128 half = _mm_set1_ps(0.5f);
+  const __m128 scale = _mm_set1_ps(static_cast<float>(lut.getSize() - 1));
+  const __m128 minWdiv = _mm_set1_ps(0.0001f);
+  const __m128 target = _mm_set1_ps(targetTime);
+
+  alignas(16) int index[4];
+  alignas(16) float values[4];
+
+  std::size_t x = 0;
+  for(; x + 4 <= width; x += 4)
+  {
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      __m128 wsum = zero;
+      __m128 wdiv = zero;
+
+      for(std::size_t i = 0; i < nbImages; ++i)
+      {
+        //no gather before AVX2, load 4 strided samples
+        const float *src = sources[i] + x * srcChannels + channel;
+        const __m128 v = _mm_setr_ps(src[0], src[srcChannels], src[2 * srcChannels], src[3 * srcChannels]);
+
+        //clamp (NaN goes to 0) and round to the nearest table index
+        const __m128 clamped = _mm_min_ps(_mm_max_ps(v, zero), one);
+        _mm_store_si128(reinterpret_cast<__m128i*>(index), _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(clamped, scale), half)));
+
+        const float *lutWsum = lut.getWsum(i, channel);
+        const float *lutWdiv = lut.getWdiv(i, channel);
+        wsum = _mm_add_ps(wsum, _mm_setr_ps(lutWsum[index[0]], lutWsum[index[1]], lutWsum[index[2]], lutWsum[index[3]]));
+        wdiv = _mm_add_ps(wdiv, _mm_setr_ps(lutWdiv[index[0]], lutWdiv[index[1]], lutWdiv[index[2]], lutWdiv[index[3]]));
+      }
+
+      const __m128 valid = _mm_cmpgt_ps(wdiv, minWdiv);
+      _mm_store_ps(values, _mm_and_ps(valid, _mm_mul_ps(_mm_div_ps(wsum, wdiv), target)));
+
+      for(std::size_t j = 0; j < 4; ++j)
+      {
+        radiance[(x + j) * dstChannels + channel] = values[j];
+      }
+    }
+  }
+  mergeRowTail(lut, sources, srcChannels, x, width, radiance, dstChannels, targetTime);
+}
+
+template<std::size_t kNbExposures>
+__attribute__((target("avx2")))
+static void mergeRowAvx2(const MergeLut &lut,
+                         const float * const *sources,
+                         std::size_t srcChannels,
+                         std::size_t width,
+                         float *radiance,
+                         std::size_t dstChannels,
+                         float targetTime)
+{
+  assert((kNbExposures == 0) || (kNbExposures == lut.getNbExposures()));
+
+  const std::size_t nbImages = (kNbExposures > 0) ? kNbExposures : lut.getNbExposures();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 scale = _mm256_set1_ps(static_cast<float>(lut.getSize() - 1));
+  const __m256 minWdiv = _mm256_set1_ps(0.0001f);
+  const __m256 target = _mm256_set1_ps(targetTime);
+  const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(srcChannels)));
+
+  alignas(32) float values[8];
+
+  std::size_t x = 0;
+  for(; x + 8 <= width; x += 8)
+  {
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      __m256 wsum = zero;
+      __m256 wdiv = zero;
+
+      //fully unrolled for the exposure counts of the common brackets
+#pragma GCC unroll 9
+      for(std::size_t i = 0; i < nbImages; ++i)
+      {
+        const __m256 v = _mm256_i32gather_ps(sources[i] + x * srcChannels + channel, offsets, 4);
+
+        //clamp (NaN goes to 0) and round to the nearest table index
+        const __m256 clamped = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+        const __m256i index = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(clamped, scale), half));
+
+        wsum = _mm256_add_ps(wsum, _mm256_i32gather_ps(lut.getWsum(i, channel), index, 4));
+        wdiv = _mm256_add_ps(wdiv, _mm256_i32gather_ps(lut.getWdiv(i, channel), index, 4));
+      }
+
+      const __m256 valid = _mm256_cmp_ps(wdiv, minWdiv, _CMP_GT_OQ);
+      _mm256_store_ps(values, _mm256_and_ps(valid, _mm256_mul_ps(_mm256_div_ps(wsum, wdiv), target)));
+
+      for(std::size_t j = 0; j < 8; ++j)
+      {
+        radiance[(x + j) * dstChannels + channel] = values[j];
+      }
+    }
+  }
+  mergeRowTail(lut, sources, srcChannels, x, width, radiance, dstChannels, targetTime);
+}
+
+template<std::size_t kNbExposures>
+__attribute__((target("avx512f")))
+static void mergeRowAvx512(const MergeLut &lut,
+                           const float * const *sources,
+                           std::size_t srcChannels,
+                           std::size_t width,
+                           float *radiance,
+                           std::size_t dstChannels,
+                           float targetTime)
+{
+  assert((kNbExposures == 0) || (kNbExposures == lut.getNbExposures()));
+
+  const std::size_t nbImages = (kNbExposures > 0) ? kNbExposures : lut.getNbExposures();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+
+  const __m512 zero = _mm512_setzero_ps();
+  const __m512 one = _mm512_set1_ps(1.0f);
+  const __m512 half = _mm512_set1_ps(0.5f);
+  const __m512 scale = _mm512_set1_ps(static_cast<float>(lut.getSize() - 1));
+  const __m512 minWdiv = _mm512_set1_ps(0.0001f);
+  const __m512 target = _mm512_set1_ps(targetTime);
+  const __m512i offsets = _mm512_mullo_epi32(_mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                                             _mm512_set1_epi32(static_cast<int>(srcChannels)));
+
+  alignas(64) float values[16];
+
+  std::size_t x = 0;
+  for(; x + 16 <= width; x += 16)
+  {
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      __m512 wsum = zero;
+      __m512 wdiv = zero;
+
+      //fully unrolled for the exposure counts of the common brackets
+#pragma GCC unroll 9
+      for(std::size_t i = 0; i < nbImages; ++i)
+      {
+        const __m512 v = _mm512_i32gather_ps(offsets, sources[i] + x * srcChannels + channel, 4);
+
+        //clamp (NaN goes to 0) and round to the nearest table index
+        const __m512 clamped = _mm512_min_ps(_mm512_max_ps(v, zero), one);
+        const __m512i index = _mm512_cvttps_epi32(_mm512_add_ps(_mm512_mul_ps(clamped, scale), half));
+
+        wsum = _mm512_add_ps(wsum, _mm512_i32gather_ps(index, lut.getWsum(i, channel), 4));
+        wdiv = _mm512_add_ps(wdiv, _mm512_i32gather_ps(index, lut.getWdiv(i, channel), 4));
+      }
+
+      const __mmask16 valid = _mm512_cmp_ps_mask(wdiv, minWdiv, _CMP_GT_OQ);
+      _mm512_store_ps(values, _mm512_maskz_mul_ps(valid, _mm512_div_ps(wsum, wdiv), target));
+
+      for(std::size_t j = 0; j < 16; ++j)
+      {
+        radiance[(x + j) * dstChannels + channel] = values[j];
+      }
+    }
+  }
+  mergeRowTail(lut, sources, srcChannels, x, width, radiance, dstChannels, targetTime);
+}
+
+/**
+ * @brief Table indexes of 8 float samples
+ */
+__attribute__((target("avx2")))
+static inline __m256i loadIndexesAvx2(const MergeLut &lut, const float *src, std::size_t srcChannels)
+{
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 half = _mm256_set1_ps(0.5f);
+  const __m256 scale = _mm256_set1_ps(static_cast<float>(lut.getSize() - 1));
+  const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(srcChannels)));
+
+  //clamp (NaN goes to 0) and round to the nearest table index
+  const __m256 v = _mm256_i32gather_ps(src, offsets, 4);
+  const __m256 clamped = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+  return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(clamped, scale), half));
+}
+
+/**
+ * @brief Table indexes of 8 integer samples, the code values
+ */
+template<typename CodeType>
+__attribute__((target("avx2")))
+static inline __m256i loadIndexesAvx2(const MergeLut &, const CodeType *src, std::size_t srcChannels)
+{
+  alignas(32) int codes[8];
+  for(std::size_t j = 0; j < 8; ++j)
+  {
+    codes[j] = src[j * srcChannels];
+  }
+  return _mm256_load_si256(reinterpret_cast<const __m256i*>(codes));
+}
+
+/**
+ * @brief AVX2 kernel skipping the black and saturated exposures of each sample
+ * The exposure range of each lane is computed without branches, the gathers of the exposures
+ * out of the range of a lane are masked. Exposures out of the range of all the lanes are not loaded.
+ */
+template<typename SourceType>
+__attribute__((target("avx2")))
+static void mergeRowSkipAvx2(const MergeLut &lut,
+                             const SourceType * const *sources,
+                             std::size_t srcChannels,
+                             std::size_t width,
+                             float *radiance,
+                             std::size_t dstChannels,
+                             float targetTime)
+{
+  assert(lut.isSkipping());
+
+  const std::vector<std::size_t> &order = lut.getTimeOrder();
+  const std::size_t nbImages = order.size();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 minWdiv = _mm256_set1_ps(0.0001f);
+  const __m256 target = _mm256_set1_ps(targetTime);
+  const __m256i lastImage = _mm256_set1_epi32(static_cast<int>(nbImages) - 1);
+
+  RowArray<int, kStackExposures * 8> indexes(nbImages * 8);
+  alignas(32) int firsts[8];
+  alignas(32) int lasts[8];
+  alignas(32) float values[8];
+
+  std::size_t x = 0;
+  for(; x + 8 <= width; x += 8)
+  {
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      //an index is black under blackLimit and saturated over saturatedLimit
+      const __m256i blackLimit = _mm256_set1_epi32(lut.getBlackIndex(channel) + 1);
+      const __m256i saturatedLimit = _mm256_set1_epi32(lut.getSaturatedIndex(channel) - 1);
+      __m256i first = _mm256_setzero_si256();
+      __m256i last = lastImage;
+
+      for(std::size_t k = 0; k < nbImages; ++k)
+      {
+        const __m256i position = _mm256_set1_epi32(static_cast<int>(k));
+        const __m256i index = loadIndexesAvx2(lut, sources[order[k]] + x * srcChannels + channel, srcChannels);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(&indexes[k * 8]), index);
+
+        //longest black exposure and shortest saturated exposure of each lane
+        first = _mm256_blendv_epi8(first, position, _mm256_cmpgt_epi32(blackLimit, index));
+        last = _mm256_min_epi32(last, _mm256_blendv_epi8(lastImage, position, _mm256_cmpgt_epi32(index, saturatedLimit)));
+      }
+      first = _mm256_min_epi32(first, last);
+
+      _mm256_store_si256(reinterpret_cast<__m256i*>(firsts), first);
+      _mm256_store_si256(reinterpret_cast<__m256i*>(lasts), last);
+      const int begin = *std::min_element(firsts, firsts + 8);
+      const int end = *std::max_element(lasts, lasts + 8);
+
+      __m256 wsum = zero;
+      __m256 wdiv = zero;
+
+      for(int k = begin; k <= end; ++k)
+      {
+        const __m256i position = _mm256_set1_epi32(k);
+        const __m256i outside = _mm256_or_si256(_mm256_cmpgt_epi32(first, position), _mm256_cmpgt_epi32(position, last));
+        const __m256 active = _mm256_castsi256_ps(_mm256_xor_si256(outside, _mm256_set1_epi32(-1)));
+        const __m256i index = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&indexes[k * 8]));
+
+        wsum = _mm256_add_ps(wsum, _mm256_mask_i32gather_ps(zero, lut.getWsum(order[k], channel), index, active, 4));
+        wdiv = _mm256_add_ps(wdiv, _mm256_mask_i32gather_ps(zero, lut.getWdiv(order[k], channel), index, active, 4));
+      }
+
+      const __m256 valid = _mm256_cmp_ps(wdiv, minWdiv, _CMP_GT_OQ);
+      _mm256_store_ps(values, _mm256_and_ps(valid, _mm256_mul_ps(_mm256_div_ps(wsum, wdiv), target)));
+
+      for(std::size_t j = 0; j < 8; ++j)
+      {
+        radiance[(x + j) * dstChannels + channel] = values[j];
+      }
+    }
+  }
+  mergeRowTail<SourceType>(&mergeRowSkip<SourceType>, lut, sources, srcChannels, x, width, radiance, dstChannels, targetTime);
+}
+
+/**
+ * @brief 8 float samples
+ */
+__attribute__((target("avx2")))
+static inline __m256 loadValuesAvx2(const float *src, std::size_t srcChannels)
+{
+  const __m256i offsets = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(static_cast<int>(srcChannels)));
+  return _mm256_i32gather_ps(src, offsets, 4);
+}
+
+/**
+ * @brief 8 integer samples, normalized
+ */
+template<typename CodeType>
+__attribute__((target("avx2")))
+static inline __m256 loadValuesAvx2(const CodeType *src, std::size_t srcChannels)
+{
+  const __m256 normalize = _mm256_set1_ps(1.0f / static_cast<float>(std::numeric_limits<CodeType>::max()));
+  alignas(32) int codes[8];
+  for(std::size_t j = 0; j < 8; ++j)
+  {
+    codes[j] = src[j * srcChannels];
+  }
+  return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_load_si256(reinterpret_cast<const __m256i*>(codes))), normalize);
+}
+
+/**
+ * @brief AVX2 kernel of a linear merge, no table lookup
+ */
+template<typename SourceType, std::size_t kNbExposures>
+__attribute__((target("avx2")))
+static void mergeRowLinearAvx2(const MergeLut &lut,
+                               const SourceType * const *sources,
+                               std::size_t srcChannels,
+                               std::size_t width,
+                               float *radiance,
+                               std::size_t dstChannels,
+                               float targetTime)
+{
+  assert(lut.isLinear());
+  assert((kNbExposures == 0) || (kNbExposures == lut.getNbExposures()));
+
+  const std::size_t nbImages = (kNbExposures > 0) ? kNbExposures : lut.getNbExposures();
+  const std::size_t nbChannels = std::min<std::size_t>(dstChannels, 3);
+  const float *inverseTimes = lut.getInverseTimes();
+
+  const __m256 zero = _mm256_setzero_ps();
+  const __m256 one = _mm256_set1_ps(1.0f);
+  const __m256 scale = _mm256_set1_ps(targetTime / static_cast<float>(nbImages));
+
+  alignas(32) float values[8];
+
+  std::size_t x = 0;
+  for(; x + 8 <= width; x += 8)
+  {
+    for(std::size_t channel = 0; channel < nbChannels; ++channel)
+    {
+      __m256 sum = zero;
+
+      //fully unrolled for the exposure counts of the common brackets
+#pragma GCC unroll 9
+      for(std::size_t i = 0; i < nbImages; ++i)
+      {
+        //clamp (NaN goes to 0)
+        const __m256 v = loadValuesAvx2(sources[i] + x * srcChannels + channel, srcChannels);
+        const __m256 clamped = _mm256_min_ps(_mm256_max_ps(v, zero), one);
+        sum = _mm256_add_ps(sum, _mm256_mul_ps(clamped, _mm256_set1_ps(inverseTimes[i])));
+      }
+
+      _mm256_store_ps(values, _mm256_mul_ps(sum, scale));
+
+      for(std::size_t j = 0; j < 8; ++j)
+      {
+        radiance[(x + j) * dstChannels + channel] = values[j];
+      }
+    }
+  }
+  mergeRowTail<SourceType>(&mergeRowLinear<SourceType>, lut, sources, srcChannels, x, width, radiance, dstChannels, targetTime);
+}
+
+#endif
+
+bool isMergeKernelSupported(EMergeKernel kernel)
+{
+  if(kernel == eMergeKernelScalar)
+  {
+    return true;
+  }
+#ifdef HDR_MERGE_X86_KERNELS
+  __builtin_cpu_init();
+  switch(kernel)
+  {
+    case eMergeKernelSse42 : return __builtin_cpu_supports("sse4.2");
+    case eMergeKernelAvx2 : return __builtin_cpu_supports("avx2");
+    case eMergeKernelAvx512 : return __builtin_cpu_supports("avx512f");
+    default : break;
+  }
+#endif
+  return false;
+}
+
+EMergeKernel getBestMergeKernel()
+{
+  if(isMergeKernelSupported(eMergeKernelAvx512))
+    return eMergeKernelAvx512;
+  if(isMergeKernelSupported(eMergeKernelAvx2))
+    return eMergeKernelAvx2;
+  if(isMergeKernelSupported(eMergeKernelSse42))
+    return eMergeKernelSse42;
+  return eMergeKernelScalar;
+}
+
+template<>
+MergeRow<float>::Function getMergeRowFunction<float>(EMergeKernel kernel)
+{
+  if(!isMergeKernelSupported(kernel))
+  {
+    return &mergeRowScalar;
+  }
+  switch(kernel)
+  {
+#ifdef HDR_MERGE_X86_KERNELS
+    case eMergeKernelSse42 : return &mergeRowSse42;
+    case eMergeKernelAvx2 : return &mergeRowAvx2<0>;
+    case eMergeKernelAvx512 : return &mergeRowAvx512<0>;
+#endif
+    default : return &mergeRowScalar;
+  }
+}
+
+//Half samples converted at once, the float chunks of all the exposures stay in the L1 cache
+static const std::size_t kHalfChunkSize = 256;
+static const std::size_t kHalfStackSamples = 4096;
+
+/**
+ * @brief Kernel of half sources, the float kernel of the tables merges converted chunks of the row
+ * The merge resolves the float kernel once and stages its own float tiles, this row function
+ * serves the callers of the half kernels.
+ */
+template<EMergeKernel kernel>
+static void mergeRowHalf(const MergeLut &lut,
+                         const Half * const *sources,
+                         std::size_t srcChannels,
+                         std::size_t width,
+                         float *radiance,
+                         std::size_t dstChannels,
+                         float targetTime)
+{
+  const MergeRowFunction mergeRow = getMergeRowFunction<float>(kernel, lut);
+
+  //chunks of all the exposures fit the stack buffer
+  const std::size_t nbImages = lut.getNbExposures();
+  const std::size_t chunkPixels = std::min(kHalfChunkSize, std::max<std::size_t>(kHalfStackSamples / (nbImages * srcChannels), 1));
+  const std::size_t chunkSize = chunkPixels * srcChannels;
+  RowArray<float, kHalfStackSamples> buffer(nbImages * chunkSize);
+  RowArray<const float*, kStackExposures> chunks(nbImages);
+
+  for(std::size_t i = 0; i < nbImages; ++i)
+  {
+    chunks[i] = &buffer[i * chunkSize];
+  }
+
+  for(std::size_t x = 0; x < width; x += chunkPixels)
+  {
+    const std::size_t nbPixels = std::min(chunkPixels, width - x);
+
+    for(std::size_t i = 0; i < nbImages; ++i)
+    {
+      //pixels of a row are contiguous
+      convertHalfToFloat(sources[i] + x * srcChannels, &buffer[i * chunkSize], nbPixels * srcChannels);
+    }
+    mergeRow(lut, chunks.data(), srcChannels, nbPixels, radiance + x * dstChannels, dstChannels, targetTime);
+  }
+}
+
+/**
+ * @brief Row function of half sources
+ */
+static MergeRow<Half>::Function getMergeRowHalfFunction(EMergeKernel kernel)
+{
+  if(!isMergeKernelSupported(kernel))
+  {
+    return &mergeRowHalf<eMergeKernelScalar>;
+  }
+  switch(kernel)
+  {
+    case eMergeKernelSse42 : return &mergeRowHalf<eMergeKernelSse42>;
+    case eMergeKernelAvx2 : return &mergeRowHalf<eMergeKernelAvx2>;
+    case eMergeKernelAvx512 : return &mergeRowHalf<eMergeKernelAvx512>;
+    default : return &mergeRowHalf<eMergeKernelScalar>;
+  }
+}
+
+template<>
+MergeRow<Half>::Function getMergeRowFunction<Half>(EMergeKernel kernel)
+{
+  return getMergeRowHalfFunction(kernel);
+}
+
+/**
+ * @brief Row function of integer sources
+ */
+template<typename SourceType>
+static typename MergeRow<SourceType>::Function getMergeRowCodesFunction(EMergeKernel kernel)
+{
+#ifdef HDR_MERGE_X86_KERNELS
+  if(((kernel == eMergeKernelAvx2) || (kernel == eMergeKernelAvx512)) && isMergeKernelSupported(eMergeKernelAvx2))
+  {
+    return &mergeRowCodesAvx2<SourceType, 0>;
+  }
+#endif
+  return &mergeRowCodes<SourceType>;
+}
+
+template<>
+MergeRow<std::uint8_t>::Function getMergeRowFunction<std::uint8_t>(EMergeKernel kernel)
+{
+  return getMergeRowCodesFunction<std::uint8_t>(kernel);
+}
+
+template<>
+MergeRow<std::uint16_t>::Function getMergeRowFunction<std::uint16_t>(EMergeKernel kernel)
+{
+  return getMergeRowCodesFunction<std::uint16_t>(kernel);
+}
+
+/**
+ * @brief Skipping row function, the SIMD kernels share the AVX2 implementation
+ */
+template<typename SourceType>
+static typename MergeRow<SourceType>::Function getMergeRowSkipFunctionOf(EMergeKernel kernel)
+{
+#ifdef HDR_MERGE_X86_KERNELS
+  if(((kernel == eMergeKernelAvx2) || (kernel == eMergeKernelAvx512)) && isMergeKernelSupported(eMergeKernelAvx2))
+  {
+    return &mergeRowSkipAvx2<SourceType>;
+  }
+#endif
+  return &mergeRowSkip<SourceType>;
+}
+
+template<>
+MergeRow<float>::Function getMergeRowSkipFunction<float>(EMergeKernel kernel)
+{
+  return getMergeRowSkipFunctionOf<float>(kernel);
+}
+
+template<>
+MergeRow<std::uint8_t>::Function getMergeRowSkipFunction<std::uint8_t>(EMergeKernel kernel)
+{
+  return getMergeRowSkipFunctionOf<std::uint8_t>(kernel);
+}
+
+template<>
+MergeRow<std::uint16_t>::Function getMergeRowSkipFunction<std::uint16_t>(EMergeKernel kernel)
+{
+  return getMergeRowSkipFunctionOf<std::uint16_t>(kernel);
+}
+
+template<>
+MergeRow<Half>::Function getMergeRowSkipFunction<Half>(EMergeKernel kernel)
+{
+  return getMergeRowHalfFunction(kernel);
+}
+
+/**
+ * @brief Table row function of integer sources, specialized on the common exposure counts
+ */
+template<typename SourceType>
+static typename MergeRow<SourceType>::Function getMergeRowCountFunction(EMergeKernel kernel, std::size_t nbExposures)
+{
+#ifdef HDR_MERGE_X86_KERNELS
+  if(((kernel == eMergeKernelAvx2) || (kernel == eMergeKernelAvx512)) && isMergeKernelSupported(eMergeKernelAvx2))
+  {
+    switch(nbExposures)
+    {
+      case 3 : return &mergeRowCodesAvx2<SourceType, 3>;
+      case 5 : return &mergeRowCodesAvx2<SourceType, 5>;
+      case 7 : return &mergeRowCodesAvx2<SourceType, 7>;
+      case 9 : return &mergeRowCodesAvx2<SourceType, 9>;
+      default : break;
+    }
+  }
+#endif
+  return getMergeRowFunction<SourceType>(kernel);
+}
+
+/**
+ * @brief Table row function of float sources, specialized on the common exposure counts
+ */
+template<>
+MergeRowFunction getMergeRowCountFunction<float>(EMergeKernel kernel, std::size_t nbExposures)
+{
+#ifdef HDR_MERGE_X86_KERNELS
+  if((kernel == eMergeKernelAvx2) && isMergeKernelSupported(kernel))
+  {
+    switch(nbExposures)
+    {
+      case 3 : return &mergeRowAvx2<3>;
+      case 5 : return &mergeRowAvx2<5>;
+      case 7 : return &mergeRowAvx2<7>;
+      case 9 : return &mergeRowAvx2<9>;
+      default : break;
+    }
+  }
+  if((kernel == eMergeKernelAvx512) && isMergeKernelSupported(kernel))
+  {
+    switch(nbExposures)
+    {
+      case 3 : return &mergeRowAvx512<3>;
+      case 5 : return &mergeRowAvx512<5>;
+      case 7 : return &mergeRowAvx512<7>;
+      case 9 : return &mergeRowAvx512<9>;
+      default : break;
+    }
+  }
+#endif
+  return getMergeRowFunction<float>(kernel);
+}
+
+/**
+ * @brief Linear row function, specialized on the common exposure counts
+ */
+template<typename SourceType>
+static typename MergeRow<SourceType>::Function getMergeRowLinearFunction(EMergeKernel kernel, std::size_t nbExposures)
+{
+#ifdef HDR_MERGE_X86_KERNELS
+  if(((kernel == eMergeKernelAvx2) || (kernel == eMergeKernelAvx512)) && isMergeKernelSupported(eMergeKernelAvx2))
+  {
+    switch(nbExposures)
+    {
+      case 3 : return &mergeRowLinearAvx2<SourceType, 3>;
+      case 5 : return &mergeRowLinearAvx2<SourceType, 5>;
+      case 7 : return &mergeRowLinearAvx2<SourceType, 7>;
+      case 9 : return &mergeRowLinearAvx2<SourceType, 9>;
+      default : return &mergeRowLinearAvx2<SourceType, 0>;
+    }
+  }
+#endif
+  return &mergeRowLinear<SourceType>;
+}
+
+/**
+ * @brief Row function of the merge tables of float and integer sources
+ */
+template<typename SourceType>
+static typename MergeRow<SourceType>::Function getMergeRowLutFunction(EMergeKernel kernel, const MergeLut &lut)
+{
+  if(lut.isLinear())
+  {
+    return getMergeRowLinearFunction<SourceType>(kernel, lut.getNbExposures());
+  }
+  if(lut.isSkipping())
+  {
+    return getMergeRowSkipFunction<SourceType>(kernel);
+  }
+  return getMergeRowCountFunction<SourceType>(kernel, lut.getNbExposures());
+}
+
+template<>
+MergeRow<float>::Function getMergeRowFunction<float>(EMergeKernel kernel, const MergeLut &lut)
+{
+  return getMergeRowLutFunction<float>(kernel, lut);
+}
+
+/**
+ * @brief Fixed point row function of 8 bits sources, specialized on the common exposure counts
+ */
+static MergeRow<std::uint8_t>::Function getMergeRowFixedFunction(EMergeKernel kernel, std::size_t nbExposures)
+{
+#ifdef HDR_MERGE_X86_KERNELS
+  if(((kernel == eMergeKernelAvx2) || (kernel == eMergeKernelAvx512)) && isMergeKernelSupported(eMergeKernelAvx2))
+  {
+    switch(nbExposures)
+    {
+      case 3 : return &mergeRowFixedAvx2<3>;
+      case 5 : return &mergeRowFixedAvx2<5>;
+      case 7 : return &mergeRowFixedAvx2<7>;
+      case 9 : return &mergeRowFixedAvx2<9>;
+      default : return &mergeRowFixedAvx2<0>;
+    }
+  }
+#endif
+  return &mergeRowFixed;
+}
+
+template<>
+MergeRow<std::uint8_t>::Function getMergeRowFunction<std::uint8_t>(EMergeKernel kernel, const MergeLut &lut)
+{
+  if(lut.isFixedPoint() && !lut.isLinear() && !lut.isSkipping())
+  {
+    return getMergeRowFixedFunction(kernel, lut.getNbExposures());
+  }
+  return getMergeRowLutFunction<std::uint8_t>(kernel, lut);
+}
+
+template<>
+MergeRow<std::uint16_t>::Function getMergeRowFunction<std::uint16_t>(EMergeKernel kernel, const MergeLut &lut)
+{
+  return getMergeRowLutFunction<std::uint16_t>(kernel, lut);
+}
+
+template<>
+MergeRow<Half>::Function getMergeRowFunction<Half>(EMergeKernel kernel, const MergeLut &)
+{
+  //the half kernels pick the float function of the tables
+  return getMergeRowHalfFunction(kernel);
+}
+
+/**
+ * @brief Reference row function of float and integer sources
+ */
+template<typename SourceType>
+static typename MergeRow<SourceType>::Function getMergeRowReferenceOf(const MergeLut &lut)
+{
+  //a linear merge is exact, its tables only sample it within half a curve step
+  if(lut.isLinear())
+  {
+    return &mergeRowLinear<SourceType>;
+  }
+  if(lut.isSkipping())
+  {
+    return &mergeRowSkip<SourceType>;
+  }
+  return &mergeRowScalar;
+}
+
+template<>
+MergeRow<float>::Function getMergeRowReferenceFunction<float>(const MergeLut &lut)
+{
+  return getMergeRowReferenceOf<float>(lut);
+}
+
+template<>
+MergeRow<std::uint8_t>::Function getMergeRowReferenceFunction<std::uint8_t>(const MergeLut &lut)
+{
+  return getMergeRowReferenceOf<std::uint8_t>(lut);
+}
+
+template<>
+MergeRow<std::uint16_t>::Function getMergeRowReferenceFunction<std::uint16_t>(const MergeLut &lut)
+{
+  return getMergeRowReferenceOf<std::uint16_t>(lut);
+}
+
+/**
+ * @brief Reference kernel of half sources, the samples are converted to float for the float reference
+ */
+static void mergeRowHalfReference(const MergeLut &lut,
+                                  const Half * const *sources,
+                                  std::size_t srcChannels,
+                                  std::size_t width,
+                                  float *radiance,
+                                  std::size_t dstChannels,
+                                  float targetTime)
+{
+  const std::size_t nbImages = lut.getNbExposures();
+  std::vector<float> buffer(nbImages * width * srcChannels);
+  std::vector<const float*> rows(nbImages);
+
+  for(std::size_t i = 0; i < nbImages; ++i)
+  {
+    convertHalfToFloat(sources[i], &buffer[i * width * srcChannels], width * srcChannels);
+    rows[i] = &buffer[i * width * srcChannels];
+  }
+  getMergeRowReferenceOf<float>(lut)(lut, rows.data(), srcChannels, width, radiance, dstChannels, targetTime);
+}
+
+template<>
+MergeRow<Half>::Function getMergeRowReferenceFunction<Half>(const MergeLut &)
+{
+  return &mergeRowHalfReference;
+}
+
+const char* getMergeKernelName(EMergeKernel kernel)
+{
+  switch(kernel)
+  {
+    case eMergeKernelSse42 : return "sse4.2";
+    case eMergeKernelAvx2 : return "avx2";
+    case eMergeKernelAvx512 : return "avx512";
+    default : return "scalar";
+  }
+}
+
+} // namespace common
+} // namespace cameraColorCalibration
@@ -0,0 +1,180 @@
+#pragma once
+#include "Half.hpp"
+#include "MergeLut.hpp"
+#include <cstddef>
+#include <cstdint>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+//Merge kernel implementations
+enum EMergeKernel
+{
+  eMergeKernelScalar = 0,
+  eMergeKernelSse42,
+  eMergeKernelAvx2,
+  eMergeKernelAvx512
+};
+
+/**
+ * @brief Merge one row of pixels
+ * @param[in] lut - contribution tables
+ * @param[in] sources - first pixel of the row in each source image
+ * @param[in] srcChannels - number of channels of the source images
+ * @param[in] width - number of pixels to merge
+ * @param[out] radiance - first pixel of the row in the radiance image
+ * @param[in] dstChannels - number of channels of the radiance image
+ * @param[in] targetTime
+ */
+template<typename SourceType>
+struct MergeRow
+{
+  typedef void (*Function)(const MergeLut &lut,
+                           const SourceType * const *sources,
+                           std::size_t srcChannels,
+                           std::size_t width,
+                           float *radiance,
+                           std::size_t dstChannels,
+                           float targetTime);
+};
+
+typedef MergeRow<float>::Function MergeRowFunction;
+
+/**
+ * @brief Reference kernel, double precision accumulation
+ */
+void mergeRowScalar(const MergeLut &lut,
+                    const float * const *sources,
+                    std::size_t srcChannels,
+                    std::size_t width,
+                    float *radiance,
+                    std::size_t dstChannels,
+                    float targetTime);
+
+/**
+ * @brief Reference kernels of integer sources, the code value is the table index
+ */
+void mergeRowScalar(const MergeLut &lut,
+                    const std::uint8_t * const *sources,
+                    std::size_t srcChannels,
+                    std::size_t width,
+                    float *radiance,
+                    std::size_t dstChannels,
+                    float targetTime);
+
+void mergeRowScalar(const MergeLut &lut,
+                    const std::uint16_t * const *sources,
+                    std::size_t srcChannels,
+                    std::size_t width,
+                    float *radiance,
+                    std::size_t dstChannels,
+                    float targetTime);
+
+/**
+ * @brief Check if the running CPU can execute a kernel
+ * @param[in] kernel
+ */
+bool isMergeKernelSupported(EMergeKernel kernel);
+
+/**
+ * @brief Fastest kernel supported by the running CPU
+ */
+EMergeKernel getBestMergeKernel();
+
+/**
+ * @brief Row function of a kernel for a source type, scalar kernel if not supported
+ * Integer sources have scalar and AVX2 kernels, the AVX-512 kernel choice runs the AVX2 kernel.
+ * Half sources are converted to float by chunks of a row for the float kernel.
+ * @param[in] kernel
+ */
+template<typename SourceType>
+typename MergeRow<SourceType>::Function getMergeRowFunction(EMergeKernel kernel);
+
+template<>
+MergeRow<float>::Function getMergeRowFunction<float>(EMergeKernel kernel);
+
+template<>
+MergeRow<std::uint8_t>::Function getMergeRowFunction<std::uint8_t>(EMergeKernel kernel);
+
+template<>
+MergeRow<std::uint16_t>::Function getMergeRowFunction<std::uint16_t>(EMergeKernel kernel);
+
+template<>
+MergeRow<Half>::Function getMergeRowFunction<Half>(EMergeKernel kernel);
+
+/**
+ * @brief Row function of a kernel for merge tables, selected once per merge
+ * Linear tables (flat weight and linear response) are merged without lookup, skipping tables
+ * with the skipping kernels. Other tables of 8 bits sources are merged by the fixed point kernels,
+ * with integer accumulators. The AVX2 and AVX-512 kernels are specialized on the exposure counts
+ * of the common brackets (3, 5, 7 and 9), the exposure loop is fully unrolled.
+ * @param[in] kernel
+ * @param[in] lut - merge tables
+ */
+template<typename SourceType>
+typename MergeRow<SourceType>::Function getMergeRowFunction(EMergeKernel kernel, const MergeLut &lut);
+
+template<>
+MergeRow<float>::Function getMergeRowFunction<float>(EMergeKernel kernel, const MergeLut &lut);
+
+template<>
+MergeRow<std::uint8_t>::Function getMergeRowFunction<std::uint8_t>(EMergeKernel kernel, const MergeLut &lut);
+
+template<>
+MergeRow<std::uint16_t>::Function getMergeRowFunction<std::uint16_t>(EMergeKernel kernel, const MergeLut &lut);
+
+template<>
+MergeRow<Half>::Function getMergeRowFunction<Half>(EMergeKernel kernel, const MergeLut &lut);
+
+/**
+ * @brief Row function skipping the black and saturated exposures, for a lut with a skip threshold
+ * The AVX2 and AVX-512 kernel choices run the AVX2 kernel, the SSE 4.2 choice the scalar kernel.
+ * @param[in] kernel
+ */
+template<typename SourceType>
+typename MergeRow<SourceType>::Function getMergeRowSkipFunction(EMergeKernel kernel);
+
+template<>
+MergeRow<float>::Function getMergeRowSkipFunction<float>(EMergeKernel kernel);
+
+template<>
+MergeRow<std::uint8_t>::Function getMergeRowSkipFunction<std::uint8_t>(EMergeKernel kernel);
+
+template<>
+MergeRow<std::uint16_t>::Function getMergeRowSkipFunction<std::uint16_t>(EMergeKernel kernel);
+
+template<>
+MergeRow<Half>::Function getMergeRowSkipFunction<Half>(EMergeKernel kernel);
+
+/**
+ * @brief Reference row function of merge tables, for the checks of the other row functions
+ * Scalar lookups of the float tables with double precision accumulation, without the SIMD,
+ * exposure count and fixed point shortcuts. Skipping tables are merged by the scalar skipping kernel,
+ * the skip changes the merged samples. Linear tables are merged by the scalar evaluation of the
+ * linear merge, without tables. Half sources are converted to float samples.
+ * @param[in] lut - merge tables
+ */
+template<typename SourceType>
+typename MergeRow<SourceType>::Function getMergeRowReferenceFunction(const MergeLut &lut);
+
+template<>
+MergeRow<float>::Function getMergeRowReferenceFunction<float>(const MergeLut &lut);
+
+template<>
+MergeRow<std::uint8_t>::Function getMergeRowReferenceFunction<std::uint8_t>(const MergeLut &lut);
+
+template<>
+MergeRow<std::uint16_t>::Function getMergeRowReferenceFunction<std::uint16_t>(const MergeLut &lut);
+
+template<>
+MergeRow<Half>::Function getMergeRowReferenceFunction<Half>(const MergeLut &lut);
+
+/**
+ * @brief Kernel name for logs and messages
+ * @param[in] kernel
+ */
+const char* getMergeKernelName(EMergeKernel kernel);
+
+} // namespace common
+} // namespace cameraColorCalibration
@@ -0,0 +1,177 @@
+#include "MergeLut.hpp"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <limits>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+constexpr float MergeLut::weightEpsilon;
+constexpr double MergeLut::minFixedWdiv;
+constexpr double MergeLut::fixedTolerance;
+
+void MergeLut::init(const std::vector<float> &times,
+                    const rgbCurve &weight,
+                    const rgbCurve &response,
+                    std::size_t nbCodes,
+                    float skipThreshold)
+{
+  assert(!response.isEmpty());
+  assert(!weight.isEmpty());
+
+  //floating point samples are rounded to a response index, integer codes are table indexes
+  _size = (nbCodes > 0) ? nbCodes : response.getSize();
+  _nbCodes = nbCodes;
+  _nbExposures = times.size();
+  _wsum.resize(_nbExposures * 3 * _size);
+  _wdiv.resize(_nbExposures * 3 * _size);
+
+  const double coefficient = 1.0 / static_cast<double>(_size - 1);
+
+  _inverseTimes.resize(_nbExposures);
+  for(std::size_t i = 0; i < _nbExposures; ++i)
+  {
+    _inverseTimes[i] = 1.0f / times[i];
+  }
+
+  //curve class, a response sampled at the nearest curve index is linear within half a curve step
+  const double tolerance = 1e-6;
+  const double responseTolerance = 0.5 / static_cast<double>(response.getSize() - 1) + tolerance;
+  _linear = true;
+
+  for(std::size_t channel = 0; channel < 3; ++channel)
+  {
+    const double flatWeight = weight(0.0f, channel);
+
+    for(std::size_t index = 0; index < _size; ++index)
+    {
+      //weight and response are sampled at the table index, curves may not have the table size
+      const double sample = index * coefficient;
+      const double w = weight(sample, channel) + weightEpsilon;
+      const double r = (nbCodes > 0) ? response(sample, channel) : response.getCurve(channel)[index];
+      const double wr = w * r;
+
+      _linear = _linear && (std::abs(w - weightEpsilon - flatWeight) <= tolerance) && (std::abs(r - sample) <= responseTolerance);
+
+      for(std::size_t i = 0; i < _nbExposures; ++i)
+      {
+        const std::size_t offset = ((i * 3) + channel) * _size + index;
+        _wsum[offset] = wr / times[i];
+        _wdiv[offset] = w;
+      }
+    }
+  }
+
+  initFixedPoint();
+
+  //exposures in increasing time, for the skip of black and saturated samples
+  _timeOrder.resize(_nbExposures);
+  for(std::size_t i = 0; i < _nbExposures; ++i)
+  {
+    _timeOrder[i] = i;
+  }
+  std::stable_sort(_timeOrder.begin(), _timeOrder.end(), [&](std::size_t a, std::size_t b) { return times[a] < times[b]; });
+
+  _skipping = (skipThreshold > 0.0f) && (_nbExposures > 1);
+
+  for(std::size_t channel = 0; channel < 3; ++channel)
+  {
+    _blackIndex[channel] = -1;
+    _saturatedIndex[channel] = static_cast<int>(_size);
+    if(!_skipping)
+    {
+      continue;
+    }
+
+    std::vector<double> w(_size);
+    for(std::size_t index = 0; index < _size; ++index)
+    {
+      w[index] = weight(index * coefficient, channel);
+    }
+    const double limit = skipThreshold * *std::max_element(w.begin(), w.end());
+
+    //black and saturated ranges start at the table ends
+    while((_blackIndex[channel] + 1 < static_cast<int>(_size)) && (w[_blackIndex[channel] + 1] < limit))
+    {
+      ++_blackIndex[channel];
+    }
+    while((_saturatedIndex[channel] - 1 > _blackIndex[channel]) && (w[_saturatedIndex[channel] - 1] < limit))
+    {
+      --_saturatedIndex[channel];
+    }
+  }
+}
+
+void MergeLut::initFixedPoint()
+{
+  _fixedWsum.clear();
+  _fixedWdiv.clear();
+
+  if(_nbCodes != common::getNbCodes<std::uint8_t>())
+  {
+    return;
+  }
+
+  const double maxWsum = *std::max_element(_wsum.begin(), _wsum.end());
+  const double minWsum = *std::min_element(_wsum.begin(), _wsum.end());
+  const double maxWdiv = *std::max_element(_wdiv.begin(), _wdiv.end());
+  if((minWsum < 0.0) || !std::isfinite(maxWsum) || !(maxWsum > 0.0))
+  {
+    //the accumulation is unsigned and scaled by the largest entry
+    return;
+  }
+
+  //the sum of one entry per exposure fits a 32 bits signed accumulator
+  const double maxSum = static_cast<double>(std::numeric_limits<std::int32_t>::max()) / static_cast<double>(_nbExposures);
+  const double wsumScale = std::floor(maxSum / maxWsum);
+  const double wdivScale = std::floor(maxSum / maxWdiv);
+  _fixedRatio = static_cast<float>(wdivScale / wsumScale);
+  _fixedMinWdiv = static_cast<std::int32_t>(std::floor(minFixedWdiv * wdivScale));
+
+  _fixedWsum.resize(_wsum.size());
+  _fixedWdiv.resize(_wdiv.size());
+  for(std::size_t offset = 0; offset < _wsum.size(); ++offset)
+  {
+    _fixedWsum[offset] = static_cast<std::int32_t>(std::floor(_wsum[offset] * wsumScale + 0.5));
+    _fixedWdiv[offset] = static_cast<std::int32_t>(std::floor(_wdiv[offset] * wdivScale + 0.5));
+  }
+
+  //wide brackets: the shared scale leaves too few bits to the longest exposures, merge with the float tables
+  if(getFixedPointError(wsumScale, wdivScale) > fixedTolerance)
+  {
+    _fixedWsum.clear();
+    _fixedWdiv.clear();
+  }
+}
+
+double MergeLut::getFixedPointError(double wsumScale, double wdivScale) const
+{
+  double maxError = 0.0;
+
+  for(std::size_t table = 0; table < _nbExposures * 3; ++table)
+  {
+    const std::size_t begin = table * _size;
+    const std::size_t end = begin + _size;
+    const double peak = *std::max_element(_wsum.begin() + begin, _wsum.begin() + end);
+
+    for(std::size_t offset = begin; offset < end; ++offset)
+    {
+      if((_wsum[offset] > 0.0f) && (_wsum[offset] >= fixedTolerance * peak))
+      {
+        const double wsum = _wsum[offset];
+        maxError = std::max(maxError, std::abs(_fixedWsum[offset] / wsumScale - wsum) / wsum);
+      }
+      if(_wdiv[offset] > 0.0f)
+      {
+        const double wdiv = _wdiv[offset];
+        maxError = std::max(maxError, std::abs(_fixedWdiv[offset] / wdivScale - wdiv) / wdiv);
+      }
+    }
+  }
+  return maxError;
+}
+
+} // namespace common
+} // namespace cameraColorCalibration
@@ -0,0 +1,259 @@
+#pragma once
+#include "rgbCurve.hpp"
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+#include <vector>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+/**
+ * @brief Number of code values of an integer source type, 0 for floating point sources
+ */
+template<typename SourceType>
+constexpr std::size_t getNbCodes()
+{
+  return std::is_integral<SourceType>::value ? (std::size_t(1) << (8 * sizeof(SourceType))) : 0;
+}
+
+/**
+ * @brief Per exposure and per channel contribution tables of a Robertson merge
+ * For an exposure i, a channel c and a curve index k :
+ *   wsum(i, c, k) = w(k) * r(k) / t(i)
+ *   wdiv(i, c, k) = w(k)
+ * with w the weight function (plus the merge epsilon) and r the response function.
+ * Tables of integer sources have one entry per code value, the code is the table index.
+ *
+ * With a skip threshold, the indexes where the weight stays under threshold * peak weight up to
+ * the table ends are black (bottom) or saturated (top). Exposures sorted by time, a pixel only
+ * needs the exposures from its longest black sample to its shortest saturated sample:
+ * the response is monotonic, the other samples are black or saturated too.
+ *
+ * With a flat weight and a linear response (r(k) = k / (size - 1)), the weight cancels out and
+ * the merge is arithmetic: the mean of the clamped samples divided by their exposure time.
+ *
+ * Tables of 8 bits sources also have a fixed point version: entries scaled so that the sum of one
+ * entry per exposure fits a 32 bits integer. The accumulation is exact, a pixel needs one float
+ * divide and the ratio of the wdiv and wsum scales. The scale is shared by all the exposures, so
+ * the entries of the longest exposures get the fewest bits: the fixed point tables are dropped
+ * when the rounding of an entry above fixedTolerance of its exposure peak exceeds fixedTolerance.
+ */
+class MergeLut
+{
+public:
+
+  /**
+   * @brief Compute all contribution tables
+   * @param[in] times - exposure time of each image
+   * @param[in] weight - weight function
+   * @param[in] response - response function
+   * @param[in] nbCodes - number of code values of integer sources, 0 for floating point sources
+   * @param[in] skipThreshold - fraction of the peak weight under which samples are black or saturated, 0 merges all the exposures
+   */
+  void init(const std::vector<float> &times,
+            const rgbCurve &weight,
+            const rgbCurve &response,
+            std::size_t nbCodes = 0,
+            float skipThreshold = 0.0f);
+
+  bool isEmpty() const
+  {
+    return _wsum.empty();
+  }
+
+  /**
+   * @brief Table index of a sample value (same rounding as rgbCurve::getIndex)
+   * @param[in] sample
+   */
+  std::size_t getIndex(float sample) const
+  {
+    if(sample < 0.0f)
+      return 0;
+    if(sample > 1.0f)
+      return _size - 1;
+    return std::size_t(std::round(sample * (_size - 1)));
+  }
+
+  /**
+   * @brief Table index of an integer code value
+   * @param[in] code
+   */
+  std::size_t getIndex(std::uint8_t code) const
+  {
+    assert(code < _size);
+    return code;
+  }
+
+  std::size_t getIndex(std::uint16_t code) const
+  {
+    assert(code < _size);
+    return code;
+  }
+
+  const float* getWsum(std::size_t exposure, std::size_t channel) const
+  {
+    assert(exposure < _nbExposures);
+    assert(channel < 3);
+    return _wsum.data() + ((exposure * 3) + channel) * _size;
+  }
+
+  const float* getWdiv(std::size_t exposure, std::size_t channel) const
+  {
+    assert(exposure < _nbExposures);
+    assert(channel < 3);
+    return _wdiv.data() + ((exposure * 3) + channel) * _size;
+  }
+
+  std::size_t getSize() const
+  {
+    return _size;
+  }
+
+  std::size_t getNbExposures() const
+  {
+    return _nbExposures;
+  }
+
+  std::size_t getNbCodes() const
+  {
+    return _nbCodes;
+  }
+
+  bool isSkipping() const
+  {
+    return _skipping;
+  }
+
+  /**
+   * @brief Flat weight and linear response, the merge doesn't need the tables
+   */
+  bool isLinear() const
+  {
+    return _linear;
+  }
+
+  /**
+   * @brief Inverse exposure time of each exposure
+   */
+  const float* getInverseTimes() const
+  {
+    return _inverseTimes.data();
+  }
+
+  /**
+   * @brief Fixed point tables of 8 bits sources, not built if an entry is negative
+   * or if the exposure times are too far apart for the precision of a shared scale
+   */
+  bool isFixedPoint() const
+  {
+    return !_fixedWsum.empty();
+  }
+
+  const std::int32_t* getFixedWsum(std::size_t exposure, std::size_t channel) const
+  {
+    assert(isFixedPoint());
+    return _fixedWsum.data() + ((exposure * 3) + channel) * _size;
+  }
+
+  const std::int32_t* getFixedWdiv(std::size_t exposure, std::size_t channel) const
+  {
+    assert(isFixedPoint());
+    return _fixedWdiv.data() + ((exposure * 3) + channel) * _size;
+  }
+
+  /**
+   * @brief wdiv scale over wsum scale, radiance = ratio * fixed wsum / fixed wdiv
+   */
+  float getFixedRatio() const
+  {
+    return _fixedRatio;
+  }
+
+  /**
+   * @brief Smallest valid fixed point wdiv sum, the merge kernels threshold
+   */
+  std::int32_t getFixedMinWdiv() const
+  {
+    return _fixedMinWdiv;
+  }
+
+  /**
+   * @brief Exposure indexes sorted by increasing time
+   */
+  const std::vector<std::size_t>& getTimeOrder() const
+  {
+    return _timeOrder;
+  }
+
+  /**
+   * @brief Last black table index of a channel, -1 if no index is black
+   * @param[in] channel
+   */
+  int getBlackIndex(std::size_t channel) const
+  {
+    assert(channel < 3);
+    return _blackIndex[channel];
+  }
+
+  /**
+   * @brief First saturated table index of a channel, table size if no index is saturated
+   * @param[in] channel
+   */
+  int getSaturatedIndex(std::size_t channel) const
+  {
+    assert(channel < 3);
+    return _saturatedIndex[channel];
+  }
+
+  /**
+   * @brief Epsilon added to the weight function, keeps clipped samples from cancelling a pixel
+   */
+  static constexpr float weightEpsilon = 0.001f;
+
+  /**
+   * @brief Smallest valid wdiv sum of the fixed point kernels, the threshold of the float kernels
+   */
+  static constexpr double minFixedWdiv = 0.0001;
+
+  /**
+   * @brief Largest relative rounding error of the fixed point entries, the merge kernels tolerance
+   */
+  static constexpr double fixedTolerance = 1e-3;
+
+private:
+
+  /**
+   * @brief Quantize the tables of 8 bits sources
+   */
+  void initFixedPoint();
+
+  /**
+   * @brief Largest relative rounding error of the fixed point entries that matter to the merge
+   * An entry matters from fixedTolerance of the largest entry of its exposure and channel.
+   * @param[in] wsumScale
+   * @param[in] wdivScale
+   */
+  double getFixedPointError(double wsumScale, double wdivScale) const;
+
+  std::vector<float> _wsum;
+  std::vector<float> _wdiv;
+  std::size_t _size = 0;
+  std::size_t _nbExposures = 0;
+  std::size_t _nbCodes = 0;
+  bool _skipping = false;
+  bool _linear = false;
+  std::vector<std::int32_t> _fixedWsum;
+  std::vector<std::int32_t> _fixedWdiv;
+  float _fixedRatio = 0.0f;
+  std::int32_t _fixedMinWdiv = 0;
+  std::vector<float> _inverseTimes;
+  std::vector<std::size_t> _timeOrder;
+  int _blackIndex[3] = {-1, -1, -1};
+  int _saturatedIndex[3] = {0, 0, 0};
+};
+
+} // namespace common
+} // namespace cameraColorCalibration
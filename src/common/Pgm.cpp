@@ -0,0 +1,142 @@
+#include "Pgm.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <fstream>
+#include <stdexcept>
+#include <vector>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+/**
+ * @brief Read a decimal value of the PGM header, skipping whitespaces and comments
+ * @param[in,out] file
+ */
+static std::size_t readPgmValue(std::istream &file)
+{
+  int c = file.get();
+  while(file && (std::isspace(c) || (c == '#')))
+  {
+    if(c == '#')
+    {
+      //comments run to the end of the line
+      while(file && (c != '\n'))
+      {
+        c = file.get();
+      }
+    }
+    c = file.get();
+  }
+
+  if(!file || !std::isdigit(c))
+  {
+    throw std::logic_error("Invalid PGM header");
+  }
+
+  std::size_t value = 0;
+  while(file && std::isdigit(c))
+  {
+    value = value * 10 + static_cast<std::size_t>(c - '0');
+    c = file.get();
+  }
+
+  //a single whitespace ends the value, the raster starts after the maximum value
+  if(!file || !std::isspace(c))
+  {
+    throw std::logic_error("Invalid PGM header");
+  }
+  return value;
+}
+
+void readPgm(const std::string &path, Image<std::uint16_t> &image)
+{
+  std::ifstream file(path, std::ios::binary);
+
+  if(!file)
+  {
+    throw std::logic_error("Can't open PGM file");
+  }
+
+  char magic[2] = {0, 0};
+  file.read(magic, 2);
+  if(!file || (magic[0] != 'P') || (magic[1] != '5'))
+  {
+    throw std::logic_error("Not a binary PGM file");
+  }
+
+  const std::size_t width = readPgmValue(file);
+  const std::size_t height = readPgmValue(file);
+  const std::size_t maxValue = readPgmValue(file);
+  if((width == 0) || (height == 0) || (maxValue == 0) || (maxValue > 65535))
+  {
+    throw std::logic_error("Invalid PGM header");
+  }
+
+  //samples of more than 8 bits are 2 bytes, most significant byte first
+  const std::size_t sampleSize = (maxValue < 256) ? 1 : 2;
+  std::vector<unsigned char> row(width * sampleSize);
+  const double scale = 65535.0 / static_cast<double>(maxValue);
+
+  image.createInternalBuffer(width, height, 1);
+
+  for(std::size_t y = 0; y < height; ++y)
+  {
+    file.read(reinterpret_cast<char*>(row.data()), row.size());
+    if(!file)
+    {
+      throw std::logic_error("Truncated PGM file");
+    }
+
+    std::uint16_t *ptr = image.getPixel(0, y);
+    for(std::size_t x = 0; x < width; ++x)
+    {
+      const std::size_t value = (sampleSize == 1) ? row[x] : ((std::size_t(row[2 * x]) << 8) | row[2 * x + 1]);
+      ptr[x] = static_cast<std::uint16_t>(std::min(65535.0, std::floor(value * scale + 0.5)));
+    }
+  }
+}
+
+void writePgm(const std::string &path, const Image<float> &image, float whiteLevel)
+{
+  if(image.getNbChannels() != 1)
+  {
+    throw std::logic_error("PGM files have a single channel");
+  }
+
+  std::ofstream file(path, std::ios::binary);
+
+  if(!file)
+  {
+    throw std::logic_error("Can't create PGM file");
+  }
+
+  file << "P5\n" << image.getWidth() << " " << image.getHeight() << "\n65535\n";
+
+  std::vector<unsigned char> row(image.getWidth() * 2);
+  const float coefficient = (whiteLevel > 0.f) ? 1.f / whiteLevel : 0.f;
+
+  for(std::size_t y = 0; y < image.getHeight(); ++y)
+  {
+    const float *ptr = image.getPixel(0, y);
+    for(std::size_t x = 0; x < image.getWidth(); ++x)
+    {
+      //clamp (NaN goes to 0)
+      const float value = ptr[x] * coefficient;
+      const float clamped = (value > 0.f) ? std::min(value, 1.f) : 0.f;
+      const std::uint16_t code = static_cast<std::uint16_t>(clamped * 65535.f + 0.5f);
+      row[2 * x] = static_cast<unsigned char>(code >> 8);
+      row[2 * x + 1] = static_cast<unsigned char>(code & 0xFF);
+    }
+    file.write(reinterpret_cast<const char*>(row.data()), row.size());
+  }
+
+  if(!file)
+  {
+    throw std::logic_error("Can't write PGM file");
+  }
+}
+
+} // namespace common
+} // namespace cameraColorCalibration
@@ -0,0 +1,29 @@
+#pragma once
+#include "Image.hpp"
+#include <cstdint>
+#include <string>
+
+
+namespace cameraColorCalibration {
+namespace common {
+
+/**
+ * @brief Read a binary (P5) PGM file, 8 or 16 bits, for raw mosaics exported without a camera SDK
+ * Samples are scaled from the file maximum value to the 16 bits range.
+ * The image has one channel and no CFA pattern, the caller sets the pattern of a mosaic.
+ * @param[in] path
+ * @param[out] image
+ */
+void readPgm(const std::string &path, Image<std::uint16_t> &image);
+
+/**
+ * @brief Write a single channel image (a merged radiance mosaic) as a 16 bits binary PGM file
+ * Samples are divided by the white level, clamped to [0, 1] and quantized to 16 bits.
+ * @param[in] path
+ * @param[in] image - single channel image
+ * @param[in] whiteLevel - sample value written as the maximum code
+ */
+void writePgm(const std::string &path, const Image<float> &image, float whiteLevel);
+
+} // namespace common
+} // namespace cameraColorCalibration
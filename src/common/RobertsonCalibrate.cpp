@@ -23,14 +23,21 @@ void RobertsonCalibrate::process(const std::vector< std::vector< Image<float> >
   //set channels count always RGB
   static const std::size_t channels = 3;
 
+  //a Bayer mosaic has one sample per pixel, the sample color selects the curve
+  const Image<float> &reference = ldrImageGroups[0][0];
+  const bool mosaic = (reference.getCfaPattern() != eCfaNone);
+  const std::size_t nbSamples = mosaic ? 1 : channels;
+
   //get channels quantization
-  std::size_t channelQuantization = ldrImageGroups[0][0].getChannelQuantization();
+  std::size_t channelQuantization = reference.getChannelQuantization();
 
   //create radiance vector of image
   _radiance = std::vector< Image<float> >(ldrImageGroups.size());
   for(auto& radianceImg: _radiance)
   {
-    radianceImg.createInternalBuffer(ldrImageGroups[0][0].getWidth(), ldrImageGroups[0][0].getHeight(), channels);
+    radianceImg.createInternalBuffer(reference.getWidth(), reference.getHeight(), nbSamples);
+    radianceImg.setOrigin(reference.getBounds().x1, reference.getBounds().y1);
+    radianceImg.setCfaPattern(reference.getCfaPattern());
   }
 
   //initialize response
@@ -58,8 +65,10 @@ void RobertsonCalibrate::process(const std::vector< std::vector< Image<float> >
         {
           const float *ptr = image.getPixel(x, y);
           
-          for(std::size_t channel = 0; channel < channels; ++channel) 
+          for(std::size_t sample = 0; sample < nbSamples; ++sample) 
           {
+            const std::size_t channel = mosaic ? image.getCfaColor(x, y) : sample;
+
             //number of pixel with the same value 
             card(*ptr, channel) += 1; 
             
@@ -110,8 +119,10 @@ void RobertsonCalibrate::process(const std::vector< std::vector< Image<float> >
             const float *ptr = ldrImagesGroup[i].getPixel(x, y);
             float *ptrRadiance = radiance.getPixel(x, y);
 
-            for(std::size_t channel = 0; channel < channels; ++channel)
+            for(std::size_t sample = 0; sample < nbSamples; ++sample)
             {
+                const std::size_t channel = mosaic ? ldrImagesGroup[i].getCfaColor(x, y) : sample;
+
                 newResponse(*ptr, channel) += times[g][i] * (*ptrRadiance);
 
                 ++ptr;
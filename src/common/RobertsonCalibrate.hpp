@@ -21,6 +21,7 @@ public:
 
   /**
    * @brief
+   * Groups of Bayer mosaics calibrate each curve on the samples of its color.
    * @param[in] groups
    * @param[out] response
    * @param[in] times
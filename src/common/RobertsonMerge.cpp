@@ -1,14 +1,22 @@
 #include "RobertsonMerge.hpp"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
-#include <limits>
 #include <iostream>
+#include <numeric>
+#include <type_traits>
 
 
 namespace cameraColorCalibration {
 namespace common {
+
+constexpr double RobertsonMerge::kernelTolerance;
+constexpr std::size_t RobertsonMerge::kStagingExposures;
+constexpr std::size_t RobertsonMerge::kDefaultStagingBytes;
+constexpr std::size_t RobertsonMerge::kHalfTileWidth;
   
-void RobertsonMerge::process(const std::vector< Image<float> > &images, 
+template<typename SourceType>
+void RobertsonMerge::process(const std::vector< Image<SourceType> > &images, 
                               const std::vector<float> &times,
                               const rgbCurve &weight,
                               const rgbCurve &response,
@@ -17,94 +25,786 @@ void RobertsonMerge::process(const std::vector< Image<float> > &images,
 {
   //checks
   assert(!response.isEmpty());
+  assert(images.size() == times.size());
+
+  //weight, response and times are constant for the whole image
+  _cfaPattern = images.front().getCfaPattern();
+  init(times, weight, response, getNbCodes<SourceType>());
+
+  process(images, radiance, targetTime);
+}
+
+/**
+ * @brief Copy of a curve with its channels reordered
+ * @param[in] curve
+ * @param[in] channels - curve channel of each channel of the copy
+ */
+static rgbCurve getReorderedCurve(const rgbCurve &curve, const std::size_t channels[3])
+{
+  rgbCurve reordered(curve);
+  for(std::size_t channel = 0; channel < 3; ++channel)
+  {
+    reordered.getCurve(channel) = curve.getCurve(channels[channel]);
+  }
+  return reordered;
+}
+
+void RobertsonMerge::init(const std::vector<float> &times,
+                          const rgbCurve &weight,
+                          const rgbCurve &response,
+                          std::size_t nbCodes)
+{
+  if(_cfaPattern == eCfaNone)
+  {
+    _lut.init(times, weight, response, nbCodes, _skipThreshold);
+    return;
+  }
+
+  for(int parity = 0; parity < 2; ++parity)
+  {
+    //a mosaic row has two colors, the colors sum to 3 - the missing color
+    const std::size_t even = getCfaColor(_cfaPattern, 0, parity);
+    const std::size_t odd = getCfaColor(_cfaPattern, 1, parity);
+    const std::size_t channels[3] = {even, odd, 3 - even - odd};
+
+    _mosaicLuts[parity].init(times, getReorderedCurve(weight, channels), getReorderedCurve(response, channels), nbCodes, _skipThreshold);
+  }
+}
+
+/**
+ * @brief Sample type of the staging buffers, half samples are staged as float for the float kernel
+ */
+template<typename SourceType>
+struct StagingSample
+{
+  typedef SourceType Type;
+};
+
+template<>
+struct StagingSample<Half>
+{
+  typedef float Type;
+};
+
+/**
+ * @brief Samples of a source for a row function, read in place if they aren't staged
+ * @param[in] source - first sample
+ * @param[in] size - number of samples
+ * @param[out] staging - staging buffer
+ * @param[in] staged - copy the samples in the staging buffer
+ */
+template<typename SourceType>
+static const SourceType* stageSamples(const SourceType *source, std::size_t size, SourceType *staging, bool staged)
+{
+  if(!staged)
+  {
+    return source;
+  }
+  std::copy(source, source + size, staging);
+  return staging;
+}
+
+/**
+ * @brief Half samples are always converted to float in the staging buffer
+ */
+static const float* stageSamples(const Half *source, std::size_t size, float *staging, bool)
+{
+  convertHalfToFloat(source, staging, size);
+  return staging;
+}
+
+/**
+ * @brief Merge a single mosaic sample with the row function, as a pixel with the sample in both channels
+ * @param[in] mergeRow - row function of the tables
+ * @param[in] lut - tables of the sample row
+ * @param[in] sources - first sample of the row in each source image
+ * @param[in] x - sample column
+ * @param[in] channel - table channel of the sample color
+ * @param[in] targetTime
+ * @param[out] pixels - buffer of 2 samples per exposure
+ * @param[out] pixelSources - buffer of a pointer per exposure
+ */
+template<typename SourceType>
+static float mergeSample(typename MergeRow<SourceType>::Function mergeRow,
+                         const MergeLut &lut,
+                         const SourceType * const *sources,
+                         std::size_t x,
+                         std::size_t channel,
+                         float targetTime,
+                         std::vector<SourceType> &pixels,
+                         std::vector<const SourceType*> &pixelSources)
+{
+  for(std::size_t i = 0; i < lut.getNbExposures(); ++i)
+  {
+    pixels[2 * i] = sources[i][x];
+    pixels[2 * i + 1] = sources[i][x];
+    pixelSources[i] = &pixels[2 * i];
+  }
+
+  float radiance[2];
+  mergeRow(lut, pixelSources.data(), 2, 1, radiance, 2, targetTime);
+  return radiance[channel];
+}
+
+template<typename SourceType>
+void RobertsonMerge::process(const std::vector< Image<SourceType> > &images, 
+                              Image<float> &radiance, 
+                              float targetTime) const
+{
+  //checks
+  assert(!images.empty());
+
+  processRows(images, radiance, targetTime, 0, images.front().getHeight());
+}
+
+template<typename SourceType>
+void RobertsonMerge::processRows(const std::vector< Image<SourceType> > &images, 
+                                  Image<float> &radiance, 
+                                  float targetTime,
+                                  std::size_t yBegin,
+                                  std::size_t yEnd) const
+{
+  if(images.front().getCfaPattern() != eCfaNone)
+  {
+    processMosaicRows(images, radiance, targetTime, yBegin, yEnd);
+    return;
+  }
+
+  //checks
+  assert(!_lut.isEmpty());
   assert(!radiance.isEmpty());
   assert(!images.empty());
-  assert(images.size() == times.size());
-  Image<float>::checkSameDimensions(images);
-  
-  //reset radiance image
-  radiance.setZero();
+  assert(images.size() == _lut.getNbExposures());
+  assert(yEnd <= images.front().getHeight());
+  assert(_lut.getNbCodes() == getNbCodes<SourceType>());
+  Image<SourceType>::checkSameDimensions(images);
 
-  //get images width, height
+  //half sources are merged by the float kernel, resolved once for the band
+  typedef typename StagingSample<SourceType>::Type StagingType;
+  const typename MergeRow<StagingType>::Function mergeRow = getRowFunction<StagingType>(_lut);
   const std::size_t width = images.front().getWidth();
-  const std::size_t height = images.front().getHeight();
-  
-  //min and max trusted values
-  const float minTrustedValue = 0.0f - std::numeric_limits<float>::epsilon();
-  const float maxTrustedValue = 1.0f + std::numeric_limits<float>::epsilon();
+  const std::size_t srcChannels = images.front().getNbChannels();
+  const std::size_t nbChannels = radiance.getNbChannels();
+  const OfxRectI bounds = radiance.getBounds();
+  const bool correct = (_colorStage != nullptr) && !_colorStage->isIdentity();
+
+  //tiles of the sources are copied one source at a time in a staging buffer,
+  //half sources are always staged as float tiles, other rows are merged in place without staging
+  const bool convert = !std::is_same<SourceType, StagingType>::value;
+  std::size_t tileWidth = getTileWidth(images.size(), srcChannels * sizeof(StagingType), width);
+  const bool staged = convert || (tileWidth > 0);
+  if(tileWidth == 0)
+  {
+    tileWidth = convert ? std::min(kHalfTileWidth, width) : width;
+  }
+  std::vector<StagingType> staging(staged ? images.size() * tileWidth * srcChannels : 0);
+  std::vector<const StagingType*> tiles(images.size());
   
-  for(std::size_t y = 0; y < height; ++y)
+  for(std::size_t y = yBegin; y < yEnd; ++y)
   {
+    float *ptrRadiance = radiance.getPixel(0, y);
+
+    for(std::size_t x = 0; x < width; x += tileWidth)
+    {
+      const std::size_t nbPixels = std::min(tileWidth, width - x);
+
+      for(std::size_t i = 0; i < images.size(); ++i)
+      {
+        StagingType *tile = staged ? &staging[i * tileWidth * srcChannels] : nullptr;
+        tiles[i] = stageSamples(images[i].getPixel(x, y), nbPixels * srcChannels, tile, staged);
+      }
+      mergeRow(_lut, tiles.data(), srcChannels, nbPixels, ptrRadiance + x * nbChannels, nbChannels, targetTime);
+      if(correct)
+      {
+        _colorStage->applyRow(ptrRadiance + x * nbChannels, nbChannels, nbPixels, bounds.x1 + static_cast<int>(x), bounds.y1 + static_cast<int>(y));
+      }
+    }
+
+    //merging in an RGBA buffer, alpha is opaque
+    for(std::size_t channel = 3; channel < nbChannels; ++channel)
+    {
+      for(std::size_t x = 0; x < width; ++x)
+      {
+        ptrRadiance[x * nbChannels + channel] = 1.0f;
+      }
+    }
+  }
+}
+
+template<typename SourceType>
+void RobertsonMerge::processMosaicRows(const std::vector< Image<SourceType> > &images, 
+                                        Image<float> &radiance, 
+                                        float targetTime,
+                                        std::size_t yBegin,
+                                        std::size_t yEnd) const
+{
+  //checks
+  assert(!_mosaicLuts[0].isEmpty());
+  assert(images.size() == _mosaicLuts[0].getNbExposures());
+  assert(radiance.getNbChannels() == 1);
+  assert(yEnd <= images.front().getHeight());
+  assert(_mosaicLuts[0].getNbCodes() == getNbCodes<SourceType>());
+  Image<SourceType>::checkSameDimensions(images);
+
+  const OfxRectI bounds = images.front().getBounds();
+  if((images.front().getCfaPattern() != _cfaPattern) || (images.front().getNbChannels() != 1))
+  {
+    throw std::logic_error("Mosaic pattern differs from the merge tables");
+  }
+
+  //half rows are converted to float once for the two kernels of the row parities
+  typedef typename StagingSample<SourceType>::Type StagingType;
+  const typename MergeRow<StagingType>::Function mergeRows[2] = {getRowFunction<StagingType>(_mosaicLuts[0]),
+                                                                 getRowFunction<StagingType>(_mosaicLuts[1])};
+  const std::size_t width = images.front().getWidth();
+  //a view may start on an odd column, its first sample is merged alone
+  const std::size_t first = static_cast<std::size_t>(bounds.x1 & 1);
+  const std::size_t nbPairs = (width > first) ? (width - first) / 2 : 0;
+  const bool convert = !std::is_same<SourceType, StagingType>::value;
+  std::vector<StagingType> staging(convert ? images.size() * width : 0);
+  std::vector<const StagingType*> sources(images.size());
+  std::vector<const StagingType*> pairs(images.size());
+  std::vector<StagingType> pixels(2 * images.size());
+  std::vector<const StagingType*> pixelSources(images.size());
+
+  for(std::size_t y = yBegin; y < yEnd; ++y)
+  {
+    const std::size_t parity = static_cast<std::size_t>((bounds.y1 + static_cast<int>(y)) & 1);
+    const MergeLut &lut = _mosaicLuts[parity];
+
+    //first sample of the row in each images
+    for(std::size_t i = 0; i < images.size(); ++i)
+    {
+      StagingType *row = convert ? &staging[i * width] : nullptr;
+      sources[i] = stageSamples(images[i].getPixel(0, y), width, row, convert);
+      pairs[i] = sources[i] + first;
+    }
+
+    float *ptrRadiance = radiance.getPixel(0, y);
+
+    if(first == 1)
+    {
+      ptrRadiance[0] = mergeSample<StagingType>(mergeRows[parity], lut, sources.data(), 0, 1, targetTime, pixels, pixelSources);
+    }
+
+    mergeRows[parity](lut, pairs.data(), 2, nbPairs, ptrRadiance + first, 2, targetTime);
+
+    if(first + 2 * nbPairs < width)
+    {
+      ptrRadiance[width - 1] = mergeSample<StagingType>(mergeRows[parity], lut, sources.data(), width - 1, 0, targetTime, pixels, pixelSources);
+    }
+  }
+}
+
+std::size_t RobertsonMerge::getTileWidth(std::size_t nbExposures, std::size_t pixelSize, std::size_t width) const
+{
+  if((_stagingBytes == 0) || (nbExposures < kStagingExposures))
+  {
+    return 0;
+  }
+
+  //the tiles of all the exposures fit the staging buffer, in SIMD widths so that only the end
+  //of a row goes through the scalar tail, as in a row merge
+  const std::size_t simdWidth = 16;
+  const std::size_t tileWidth = std::max<std::size_t>(_stagingBytes / (nbExposures * pixelSize) / simdWidth, 1) * simdWidth;
+  return (tileWidth >= width) ? 0 : tileWidth;
+}
+
+template<typename SourceType>
+void RobertsonMerge::accumulateRows(const Image<SourceType> &image, 
+                                     std::size_t exposure,
+                                     Image<float> &wsum,
+                                     Image<float> &wdiv,
+                                     std::size_t yBegin,
+                                     std::size_t yEnd) const
+{
+  if(image.getCfaPattern() != eCfaNone)
+  {
+    throw std::logic_error("Mosaics can't be merged by exposure");
+  }
+
+  //checks
+  assert(!_lut.isEmpty());
+  assert(exposure < _lut.getNbExposures());
+  assert(wsum.getNbChannels() == 3);
+  assert(wdiv.getNbChannels() == 3);
+  assert(image.getWidth() == wsum.getWidth());
+  assert(yEnd <= image.getHeight());
+  assert(_lut.getNbCodes() == getNbCodes<SourceType>());
+
+  const std::size_t width = image.getWidth();
+  const std::size_t srcChannels = image.getNbChannels();
+  const float *lutWsum[3] = {_lut.getWsum(exposure, 0), _lut.getWsum(exposure, 1), _lut.getWsum(exposure, 2)};
+  const float *lutWdiv[3] = {_lut.getWdiv(exposure, 0), _lut.getWdiv(exposure, 1), _lut.getWdiv(exposure, 2)};
+
+  for(std::size_t y = yBegin; y < yEnd; ++y)
+  {
+    const SourceType *ptr = image.getPixel(0, y);
+    float *ptrWsum = wsum.getPixel(0, y);
+    float *ptrWdiv = wdiv.getPixel(0, y);
+
     for(std::size_t x = 0; x < width; ++x)
     {
-      //for each pixels
-      float *ptrRadiance = radiance.getPixel(x, y);
-      
-      for(std::size_t channel = 0; channel < radiance.getNbChannels(); ++channel)
+      for(std::size_t channel = 0; channel < 3; ++channel)
       {
-        double wsum = 0.0f;
-        double wdiv = 0.0f;
-//        float minTimeSaturation = std::numeric_limits<float>::max();
-//        float maxTimeSaturation = std::numeric_limits<float>::min();
+        const std::size_t index = _lut.getIndex(ptr[channel]);
 
-        for(std::size_t i = 0; i < images.size(); ++i) 
-        {
-          //for each images
-          const double value = *images[i].getPixel(x, y, channel);
-          const double time = times[i];
-          const double vt = value / time;
-          const double w = weight(value, channel) + 0.001;
-          const float r = response(value, channel);
-
-//          wsum += w * time * r;
-//          wdiv += w * time * time;
-          wsum += w * r / time;
-          wdiv += w;
-//          wsum += w * vt;
-//          wdiv += w;
-
-//          //saturation detection
-//          if(value > maxTrustedValue) 
-//          {
-//            minTimeSaturation = std::min(minTimeSaturation, time);
-//          }
-//          
-//          if(value < minTrustedValue) 
-//          {
-//            maxTimeSaturation = std::max(maxTimeSaturation, time);
-//          }
-        }
+        ptrWsum[channel] += lutWsum[channel][index];
+        ptrWdiv[channel] += lutWdiv[channel][index];
+      }
+      ptr += srcChannels;
+      ptrWsum += 3;
+      ptrWdiv += 3;
+    }
+  }
+}
+
+void RobertsonMerge::finalizeRows(const Image<float> &wsum,
+                                   const Image<float> &wdiv,
+                                   Image<float> &radiance, 
+                                   float targetTime,
+                                   std::size_t yBegin,
+                                   std::size_t yEnd,
+                                   const ColorStage *colorStage)
+{
+  //checks
+  assert(wsum.getWidth() == radiance.getWidth());
+  assert(yEnd <= radiance.getHeight());
 
-//        //saturation correction
-//        if((wdiv == 0.0f) && 
-//               (maxTimeSaturation > std::numeric_limits<float>::min())) 
-//        {
-//          wsum = minTrustedValue;
-//          wdiv = maxTimeSaturation;
-//        }
-//        
-//        if((wdiv == 0.0f) && 
-//               (minTimeSaturation < std::numeric_limits<float>::max())) 
-//        {
-//          wsum = maxTrustedValue;
-//          wdiv = minTimeSaturation;
-//        }
-
-        if(wdiv > 0.0001f) 
+  const std::size_t width = radiance.getWidth();
+  const std::size_t nbChannels = radiance.getNbChannels();
+  const OfxRectI bounds = radiance.getBounds();
+
+  for(std::size_t y = yBegin; y < yEnd; ++y)
+  {
+    const float *ptrWsum = wsum.getPixel(0, y);
+    const float *ptrWdiv = wdiv.getPixel(0, y);
+    float *ptrRadiance = radiance.getPixel(0, y);
+
+    for(std::size_t x = 0; x < width; ++x)
+    {
+      for(std::size_t channel = 0; channel < 3; ++channel)
+      {
+        if(ptrWdiv[channel] > 0.0001f)
         {
-          *ptrRadiance = (wsum / wdiv) * targetTime;
-        } 
+          ptrRadiance[channel] = (ptrWsum[channel] / ptrWdiv[channel]) * targetTime;
+        }
         else
         {
-          *ptrRadiance = 0.0f;
+          ptrRadiance[channel] = 0.0f;
         }
-        
-        ++ptrRadiance; //next channel
-      } 
+      }
+
+      //merging in an RGBA buffer, alpha is opaque
+      for(std::size_t channel = 3; channel < nbChannels; ++channel)
+      {
+        ptrRadiance[channel] = 1.0f;
+      }
+      ptrWsum += 3;
+      ptrWdiv += 3;
+      ptrRadiance += nbChannels;
+    }
+
+    if(colorStage != nullptr)
+    {
+      colorStage->applyRow(radiance.getPixel(0, y), nbChannels, width, bounds.x1, bounds.y1 + static_cast<int>(y));
     }
   }
 }
 
+void RobertsonMerge::scaleRows(const Image<float> &radiance,
+                                Image<float> &output,
+                                float targetTime,
+                                std::size_t yBegin,
+                                std::size_t yEnd,
+                                const ColorStage *colorStage)
+{
+  //checks
+  assert(radiance.getWidth() == output.getWidth());
+  assert(yEnd <= output.getHeight());
+
+  const std::size_t width = output.getWidth();
+  const std::size_t nbChannels = output.getNbChannels();
+  const std::size_t radianceChannels = radiance.getNbChannels();
+  const OfxRectI bounds = output.getBounds();
+
+  for(std::size_t y = yBegin; y < yEnd; ++y)
+  {
+    const float *ptrRadiance = radiance.getPixel(0, y);
+    float *ptr = output.getPixel(0, y);
+
+    for(std::size_t x = 0; x < width; ++x)
+    {
+      for(std::size_t channel = 0; channel < 3; ++channel)
+      {
+        ptr[channel] = ptrRadiance[channel] * targetTime;
+      }
+
+      //writing in an RGBA buffer, alpha is opaque
+      for(std::size_t channel = 3; channel < nbChannels; ++channel)
+      {
+        ptr[channel] = 1.0f;
+      }
+      ptrRadiance += radianceChannels;
+      ptr += nbChannels;
+    }
+
+    if(colorStage != nullptr)
+    {
+      colorStage->applyRow(output.getPixel(0, y), nbChannels, width, bounds.x1, bounds.y1 + static_cast<int>(y));
+    }
+  }
+}
+
+std::vector<std::size_t> RobertsonMerge::selectSpreadExposures(const std::vector<float> &times, std::size_t count)
+{
+  std::vector<std::size_t> order(times.size());
+  for(std::size_t i = 0; i < order.size(); ++i)
+  {
+    order[i] = i;
+  }
+
+  if(count >= times.size())
+  {
+    return order;
+  }
+
+  if(count == 0)
+  {
+    return std::vector<std::size_t>();
+  }
+
+  std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) { return times[a] < times[b]; });
+
+  if(count == 1)
+  {
+    return std::vector<std::size_t>(1, order[order.size() / 2]);
+  }
+
+  const double logMin = std::log(std::max(times[order.front()], 1e-12f));
+  const double logMax = std::log(std::max(times[order.back()], 1e-12f));
+
+  std::vector<bool> used(order.size(), false);
+  std::vector<std::size_t> selection;
+
+  for(std::size_t k = 0; k < count; ++k)
+  {
+    //nearest unused exposure to an even step in log time
+    const double target = logMin + (logMax - logMin) * k / (count - 1);
+    std::size_t best = order.size();
+    double bestDistance = 0.0;
+
+    for(std::size_t j = 0; j < order.size(); ++j)
+    {
+      if(used[j])
+      {
+        continue;
+      }
+      const double distance = std::abs(std::log(std::max(times[order[j]], 1e-12f)) - target);
+      if((best == order.size()) || (distance < bestDistance))
+      {
+        best = j;
+        bestDistance = distance;
+      }
+    }
+    used[best] = true;
+    selection.push_back(order[best]);
+  }
+
+  std::sort(selection.begin(), selection.end());
+  return selection;
+}
+
+template<typename SourceType>
+std::vector<std::size_t> RobertsonMerge::selectContributingExposures(const std::vector< Image<SourceType> > &images,
+                                                                     const rgbCurve &weight,
+                                                                     float fraction,
+                                                                     std::size_t gridSize)
+{
+  //coarse histograms, the weight is nearly constant over a bin
+  const std::size_t nbBins = 64;
+  const float binCoefficient = 1.f / static_cast<float>(nbBins - 1);
+
+  std::vector<double> contributions(images.size(), 0.0);
+
+  for(std::size_t i = 0; i < images.size(); ++i)
+  {
+    const Image<SourceType> &image = images[i];
+    const bool mosaic = (image.getCfaPattern() != eCfaNone);
+    const std::size_t nbChannels = std::min<std::size_t>(image.getNbChannels(), 3);
+    std::size_t step = std::max<std::size_t>(1, std::max(image.getWidth(), image.getHeight()) / std::max<std::size_t>(gridSize, 1));
+    //an odd step goes through all the colors of a mosaic
+    step += (mosaic && (step % 2 == 0)) ? 1 : 0;
+    std::vector<std::size_t> histogram(nbBins * 3, 0);
+
+    for(std::size_t y = 0; y < image.getHeight(); y += step)
+    {
+      for(std::size_t x = 0; x < image.getWidth(); x += step)
+      {
+        const SourceType *ptr = image.getPixel(x, y);
+        for(std::size_t channel = 0; channel < nbChannels; ++channel)
+        {
+          //clamp (NaN goes to 0)
+          const float value = getNormalizedValue(ptr[channel]);
+          const float clamped = (value > 0.f) ? std::min(value, 1.f) : 0.f;
+          const std::size_t color = mosaic ? image.getCfaColor(x, y) : channel;
+          ++histogram[color * nbBins + static_cast<std::size_t>(clamped * (nbBins - 1) + 0.5f)];
+        }
+      }
+    }
+
+    for(std::size_t channel = 0; channel < 3; ++channel)
+    {
+      for(std::size_t bin = 0; bin < nbBins; ++bin)
+      {
+        contributions[i] += histogram[channel * nbBins + bin] * double(weight(bin * binCoefficient, channel));
+      }
+    }
+  }
+
+  const double total = std::accumulate(contributions.begin(), contributions.end(), 0.0);
+
+  std::vector<std::size_t> selection;
+  for(std::size_t i = 0; i < images.size(); ++i)
+  {
+    if((total <= 0.0) || (contributions[i] >= fraction * total))
+    {
+      selection.push_back(i);
+    }
+  }
+  return selection;
+}
+
+/**
+ * @brief Log-average of the luminance samples
+ * @param[in] logSum - sum of log(delta + L)
+ * @param[in] count - number of samples
+ */
+static float getLogAverage(double logSum, std::size_t count)
+{
+  return (count > 0) ? static_cast<float>(std::exp(logSum / static_cast<double>(count))) : 0.f;
+}
+
+/**
+ * @brief Rec.709 luminance of a merged RGB pixel, in the log domain of the log-average
+ * @param[in] pixel - RGB radiance
+ */
+static double getLogLuminance(const float *pixel)
+{
+  //the delta keeps black pixels finite, negative and NaN luminances go to the delta
+  const double delta = 1e-6;
+  const double luminance = 0.2126 * pixel[0] + 0.7152 * pixel[1] + 0.0722 * pixel[2];
+  return std::log(delta + ((luminance > 0.0) ? luminance : 0.0));
+}
+
+/**
+ * @brief Step between the samples of the log-average grid
+ * @param[in] width - width of the sources
+ * @param[in] height - height of the sources
+ * @param[in] gridSize - number of samples along the largest side
+ */
+static std::size_t getGridStep(std::size_t width, std::size_t height, std::size_t gridSize)
+{
+  return std::max<std::size_t>(1, std::max(width, height) / std::max<std::size_t>(gridSize, 1));
+}
+
+template<typename SourceType>
+float RobertsonMerge::getLogAverageLuminance(const std::vector< Image<SourceType> > &images,
+                                             float targetTime,
+                                             std::size_t gridSize) const
+{
+  //checks
+  assert(!_lut.isEmpty());
+  assert(!images.empty());
+  assert(images.size() == _lut.getNbExposures());
+
+  if(images.front().getCfaPattern() != eCfaNone)
+  {
+    throw std::logic_error("The log-average luminance needs RGB sources");
+  }
+
+  typedef typename StagingSample<SourceType>::Type StagingType;
+  const typename MergeRow<StagingType>::Function mergeRow = getRowFunction<StagingType>(_lut);
+  const std::size_t width = images.front().getWidth();
+  const std::size_t height = images.front().getHeight();
+  const std::size_t srcChannels = images.front().getNbChannels();
+  const std::size_t step = getGridStep(width, height, gridSize);
+  const std::size_t nbSamples = (width + step - 1) / step;
+  const OfxRectI bounds = images.front().getBounds();
+  const bool correct = (_colorStage != nullptr) && !_colorStage->isIdentity();
+
+  //the samples of a grid row are gathered in a staging buffer and merged as a row
+  std::vector<StagingType> staging(images.size() * nbSamples * srcChannels);
+  std::vector<const StagingType*> samples(images.size());
+  std::vector<float> radiance(nbSamples * 3);
+  double logSum = 0.0;
+  std::size_t count = 0;
+
+  for(std::size_t y = 0; y < height; y += step)
+  {
+    for(std::size_t i = 0; i < images.size(); ++i)
+    {
+      StagingType *ptr = &staging[i * nbSamples * srcChannels];
+      for(std::size_t x = 0; x < width; x += step)
+      {
+        stageSamples(images[i].getPixel(x, y), srcChannels, ptr, true);
+        ptr += srcChannels;
+      }
+      samples[i] = &staging[i * nbSamples * srcChannels];
+    }
+
+    mergeRow(_lut, samples.data(), srcChannels, nbSamples, radiance.data(), 3, targetTime);
+
+    for(std::size_t x = 0; x < nbSamples; ++x)
+    {
+      if(correct)
+      {
+        _colorStage->applyPixel(&radiance[x * 3], bounds.x1 + static_cast<int>(x * step), bounds.y1 + static_cast<int>(y));
+      }
+      logSum += getLogLuminance(&radiance[x * 3]);
+    }
+    count += nbSamples;
+  }
+
+  return getLogAverage(logSum, count);
+}
+
+template<typename SourceType>
+void RobertsonMerge::accumulateGrid(const Image<SourceType> &image,
+                                     std::size_t exposure,
+                                     Image<float> &wsum,
+                                     Image<float> &wdiv,
+                                     std::size_t gridSize) const
+{
+  const std::size_t width = image.getWidth();
+  const std::size_t height = image.getHeight();
+  const std::size_t srcChannels = image.getNbChannels();
+  const std::size_t step = getGridStep(width, height, gridSize);
+  const std::size_t nbColumns = (width + step - 1) / step;
+  const std::size_t nbRows = (height + step - 1) / step;
+
+  if(wsum.isEmpty())
+  {
+    wsum.createInternalBuffer(nbColumns, nbRows, 3);
+    wdiv.createInternalBuffer(nbColumns, nbRows, 3);
+    wsum.setZero();
+    wdiv.setZero();
+  }
+  assert((wsum.getWidth() == nbColumns) && (wsum.getHeight() == nbRows));
+
+  //the samples of the grid are gathered in a small image and accumulated as rows
+  Image<SourceType> grid(nbColumns, nbRows, srcChannels);
+  for(std::size_t y = 0; y < nbRows; ++y)
+  {
+    SourceType *ptr = grid.getPixel(0, y);
+    for(std::size_t x = 0; x < width; x += step)
+    {
+      const SourceType *pixel = image.getPixel(x, y * step);
+      std::copy(pixel, pixel + srcChannels, ptr);
+      ptr += srcChannels;
+    }
+  }
+  accumulateRows(grid, exposure, wsum, wdiv, 0, nbRows);
+}
+
+float RobertsonMerge::getLogAverageLuminance(const Image<float> &wsum,
+                                             const Image<float> &wdiv,
+                                             const OfxRectI &bounds,
+                                             float targetTime,
+                                             std::size_t gridSize) const
+{
+  //every cell of the accumulators is a sample, at the pixel of the sources it comes from
+  const std::size_t step = getGridStep(static_cast<std::size_t>(bounds.x2 - bounds.x1), static_cast<std::size_t>(bounds.y2 - bounds.y1), gridSize);
+  const bool correct = (_colorStage != nullptr) && !_colorStage->isIdentity();
+  double logSum = 0.0;
+  std::size_t count = 0;
+
+  for(std::size_t y = 0; y < wsum.getHeight(); ++y)
+  {
+    for(std::size_t x = 0; x < wsum.getWidth(); ++x)
+    {
+      const float *ptrWsum = wsum.getPixel(x, y);
+      const float *ptrWdiv = wdiv.getPixel(x, y);
+      float pixel[3];
+      for(std::size_t channel = 0; channel < 3; ++channel)
+      {
+        pixel[channel] = (ptrWdiv[channel] > 0.0001f) ? (ptrWsum[channel] / ptrWdiv[channel]) * targetTime : 0.0f;
+      }
+      if(correct)
+      {
+        _colorStage->applyPixel(pixel, bounds.x1 + static_cast<int>(x * step), bounds.y1 + static_cast<int>(y * step));
+      }
+      logSum += getLogLuminance(pixel);
+      ++count;
+    }
+  }
+
+  return getLogAverage(logSum, count);
+}
+
+template<typename SourceType>
+double RobertsonMerge::compareWithReference(const std::vector< Image<SourceType> > &images, 
+                                            const Image<float> &radiance, 
+                                            float targetTime) const
+{
+  //merge again with the reference functions, straight from the sources and without color stage
+  RobertsonMerge reference(*this);
+  reference.setKernel(eMergeKernelScalar);
+  reference.setStagingBytes(0);
+  reference.setColorStage(nullptr);
+  reference._reference = true;
+
+  const OfxRectI bounds = radiance.getBounds();
+  Image<float> expected(radiance.getWidth(), radiance.getHeight(), radiance.getNbChannels());
+  expected.setOrigin(bounds.x1, bounds.y1);
+  reference.process(images, expected, targetTime);
+
+  //the stage corrects the plain reference radiance, at the pixel coordinates of the radiance
+  const bool correct = (_colorStage != nullptr) && (expected.getNbChannels() >= 3) && (images.front().getCfaPattern() == eCfaNone);
+  for(std::size_t y = 0; correct && (y < expected.getHeight()); ++y)
+  {
+    _colorStage->applyRow(expected.getPixel(0, y), expected.getNbChannels(), expected.getWidth(), bounds.x1, bounds.y1 + static_cast<int>(y));
+  }
+
+  double maxDifference = 0.0;
+  for(std::size_t y = 0; y < radiance.getHeight(); ++y)
+  {
+    for(std::size_t x = 0; x < radiance.getWidth(); ++x)
+    {
+      const float *ptr = radiance.getPixel(x, y);
+      const float *ptrExpected = expected.getPixel(x, y);
+
+      for(std::size_t channel = 0; channel < radiance.getNbChannels(); ++channel)
+      {
+        //relative difference, absolute near zero
+        const double difference = std::abs(double(*ptr) - double(*ptrExpected)) / std::max(1.0, std::abs(double(*ptrExpected)));
+        maxDifference = std::max(maxDifference, difference);
+
+        ++ptr;
+        ++ptrExpected;
+      }
+    }
+  }
+  return maxDifference;
+}
+
+
+//source types of the merge
+#define HDR_MERGE_INSTANTIATE(SourceType) \
+  template void RobertsonMerge::process(const std::vector< Image<SourceType> > &, const std::vector<float> &, const rgbCurve &, const rgbCurve &, Image<float> &, float); \
+  template void RobertsonMerge::process(const std::vector< Image<SourceType> > &, Image<float> &, float) const; \
+  template void RobertsonMerge::processRows(const std::vector< Image<SourceType> > &, Image<float> &, float, std::size_t, std::size_t) const; \
+  template void RobertsonMerge::processMosaicRows(const std::vector< Image<SourceType> > &, Image<float> &, float, std::size_t, std::size_t) const; \
+  template void RobertsonMerge::accumulateRows(const Image<SourceType> &, std::size_t, Image<float> &, Image<float> &, std::size_t, std::size_t) const; \
+  template float RobertsonMerge::getLogAverageLuminance(const std::vector< Image<SourceType> > &, float, std::size_t) const; \
+  template void RobertsonMerge::accumulateGrid(const Image<SourceType> &, std::size_t, Image<float> &, Image<float> &, std::size_t) const; \
+  template double RobertsonMerge::compareWithReference(const std::vector< Image<SourceType> > &, const Image<float> &, float) const; \
+  template std::vector<std::size_t> RobertsonMerge::selectContributingExposures(const std::vector< Image<SourceType> > &, const rgbCurve &, float, std::size_t);
+
+HDR_MERGE_INSTANTIATE(float)
+HDR_MERGE_INSTANTIATE(std::uint8_t)
+HDR_MERGE_INSTANTIATE(std::uint16_t)
+HDR_MERGE_INSTANTIATE(Half)
 
 } // namespace common
 } // namespace cameraColorCalibration
@@ -1,29 +1,312 @@
 #pragma once
 #include "rgbCurve.hpp"
+#include "ColorStage.hpp"
 #include "Image.hpp"
+#include "MergeLut.hpp"
+#include "MergeKernel.hpp"
 #include <cmath>
 
 
 namespace cameraColorCalibration {
 namespace common {
  
+/**
+ * @brief Robertson merge of float, half, 8 bits or 16 bits source images
+ * Source methods are instantiated for float, std::uint8_t, std::uint16_t and Half.
+ */
 class RobertsonMerge {
 public:
 
   /**
    * @brief
+   * Bayer mosaics (single channel images with a CFA pattern) are merged sample by sample
+   * with the curves of the sample color, in a single channel radiance mosaic.
    * @param images
    * @param radiance
    * @param times
    * @param targetTime
    * @param response
    */
-  void process(const std::vector< Image<float> > &images, 
+  template<typename SourceType>
+  void process(const std::vector< Image<SourceType> > &images, 
                 const std::vector<float> &times,
                 const rgbCurve &weight,
                 const rgbCurve &response,
                 Image<float> &radiance, 
                 float targetTime);
+
+  /**
+   * @brief Merge with the contribution tables of the last init
+   * RGB channels are merged, any other radiance channel (alpha) is set to 1.
+   * @param images
+   * @param radiance
+   * @param targetTime
+   */
+  template<typename SourceType>
+  void process(const std::vector< Image<SourceType> > &images, 
+                Image<float> &radiance, 
+                float targetTime) const;
+
+  /**
+   * @brief Merge a band of rows with the contribution tables of the last init
+   * Bands don't share any output, they can be merged concurrently.
+   * @param images
+   * @param radiance
+   * @param targetTime
+   * @param yBegin - first row
+   * @param yEnd - row after the last row
+   */
+  template<typename SourceType>
+  void processRows(const std::vector< Image<SourceType> > &images, 
+                    Image<float> &radiance, 
+                    float targetTime,
+                    std::size_t yBegin,
+                    std::size_t yEnd) const;
+
+  /**
+   * @brief Add the contribution of one exposure to running accumulators (streaming merge)
+   * RGB images only, mosaics are merged by processRows.
+   * @param image - source image of the exposure
+   * @param exposure - index of the exposure in the times of the last init
+   * @param wsum - RGB accumulator of weighted radiances
+   * @param wdiv - RGB accumulator of weights
+   * @param yBegin - first row
+   * @param yEnd - row after the last row
+   */
+  template<typename SourceType>
+  void accumulateRows(const Image<SourceType> &image, 
+                      std::size_t exposure,
+                      Image<float> &wsum,
+                      Image<float> &wdiv,
+                      std::size_t yBegin,
+                      std::size_t yEnd) const;
+
+  /**
+   * @brief Compute the radiance from the accumulators of all exposures (streaming merge)
+   * @param wsum - RGB accumulator of weighted radiances
+   * @param wdiv - RGB accumulator of weights
+   * @param radiance
+   * @param targetTime
+   * @param yBegin - first row
+   * @param yEnd - row after the last row
+   * @param colorStage - color corrections of the radiance rows, null for none
+   */
+  static void finalizeRows(const Image<float> &wsum,
+                           const Image<float> &wdiv,
+                           Image<float> &radiance, 
+                           float targetTime,
+                           std::size_t yBegin,
+                           std::size_t yEnd,
+                           const ColorStage *colorStage = nullptr);
+
+  /**
+   * @brief Scale an unscaled radiance (merged with a target time of 1) to a target time
+   * RGB channels are scaled, any other output channel (alpha) is set to 1.
+   * @param radiance - unscaled RGB radiance
+   * @param output
+   * @param targetTime
+   * @param yBegin - first row
+   * @param yEnd - row after the last row
+   * @param colorStage - color corrections of the output rows, null for none
+   */
+  static void scaleRows(const Image<float> &radiance,
+                        Image<float> &output,
+                        float targetTime,
+                        std::size_t yBegin,
+                        std::size_t yEnd,
+                        const ColorStage *colorStage = nullptr);
+
+  /**
+   * @brief Compute the contribution tables, constant for a whole render
+   * @param times
+   * @param weight
+   * @param response
+   * @param nbCodes - number of code values of integer sources (getNbCodes), 0 for float sources
+   */
+  void init(const std::vector<float> &times,
+            const rgbCurve &weight,
+            const rgbCurve &response,
+            std::size_t nbCodes = 0);
+
+  const MergeLut& getLut() const
+  {
+    return _lut;
+  }
+
+  ECfaPattern getCfaPattern() const
+  {
+    return _cfaPattern;
+  }
+
+  /**
+   * @brief Bayer pattern of the mosaics to merge, eCfaNone for RGB images
+   * Used by the next init.
+   * @param[in] pattern
+   */
+  void setCfaPattern(ECfaPattern pattern)
+  {
+    _cfaPattern = pattern;
+  }
+
+  /**
+   * @brief Compare a radiance merged by the current kernel with the scalar reference kernel
+   * The reference merges without the linear, exposure count, fixed point and staging shortcuts.
+   * The color stage of the merge corrects the reference at the radiance bounds.
+   * @param images
+   * @param radiance - result of process with the same images and targetTime
+   * @param targetTime
+   * @return the maximum relative difference
+   */
+  template<typename SourceType>
+  double compareWithReference(const std::vector< Image<SourceType> > &images, 
+                              const Image<float> &radiance, 
+                              float targetTime) const;
+
+  EMergeKernel getKernel() const
+  {
+    return _kernel;
+  }
+
+  void setKernel(EMergeKernel kernel)
+  {
+    _kernel = kernel;
+  }
+
+  std::size_t getStagingBytes() const
+  {
+    return _stagingBytes;
+  }
+
+  /**
+   * @brief Size of the staging buffer of the tiled merge, 0 merges the rows straight from the sources
+   * With many exposures, a row merge reads as many streams as exposures, more than the hardware
+   * prefetchers follow. The tiled merge copies a tile of each source in a staging buffer
+   * that stays in the L2 cache and merges the tiles.
+   * @param[in] bytes - staging buffer size
+   */
+  void setStagingBytes(std::size_t bytes)
+  {
+    _stagingBytes = bytes;
+  }
+
+  const ColorStage* getColorStage() const
+  {
+    return _colorStage;
+  }
+
+  /**
+   * @brief Color corrections applied to the merged RGB rows, null for none (Bayer mosaics are never corrected)
+   * @param[in] colorStage - kept by pointer, has to outlive the merges
+   */
+  void setColorStage(const ColorStage *colorStage)
+  {
+    _colorStage = colorStage;
+  }
+
+  float getSkipThreshold() const
+  {
+    return _skipThreshold;
+  }
+
+  /**
+   * @brief Skip the black and saturated exposures of each sample (see MergeLut), 0 merges all the exposures
+   * Used by the next init.
+   * @param[in] threshold - relative weight under which a sample is skipped
+   */
+  void setSkipThreshold(float threshold)
+  {
+    _skipThreshold = threshold;
+  }
+
+  /**
+   * @brief Pick exposures evenly spread in log exposure time, for a draft merge
+   * The shortest and the longest exposures are always kept.
+   * @param times - exposure time of each image
+   * @param count - number of exposures to keep
+   * @return indexes of the kept exposures, in increasing order
+   */
+  static std::vector<std::size_t> selectSpreadExposures(const std::vector<float> &times, std::size_t count);
+
+  /**
+   * @brief Pick the exposures contributing to a merge, from coarse histograms of a subsampled grid
+   * The contribution of an exposure is its total merge weight. Exposures under a fraction of the
+   * total weight of all the exposures (mostly black or saturated frames) are dropped.
+   * @param images - source images
+   * @param weight - weight function
+   * @param fraction - contribution under which an exposure is dropped, 0 keeps all the exposures
+   * @param gridSize - number of samples along the largest side of the images
+   * @return indexes of the kept exposures, in increasing order, all the exposures if none contributes
+   */
+  template<typename SourceType>
+  static std::vector<std::size_t> selectContributingExposures(const std::vector< Image<SourceType> > &images,
+                                                              const rgbCurve &weight,
+                                                              float fraction,
+                                                              std::size_t gridSize = 64);
+
+  /**
+   * @brief Log-average luminance of the radiance, merged on a subsampled grid of the sources
+   * Pre-pass of the tone-mapped output, the merge of the grid costs about 1 / step^2 of the full merge.
+   * The grid starts at the first pixel of the images, full sources give the same value to every tile.
+   * Samples get the color corrections of the color stage, without the tone mapping, at their pixel coordinates.
+   * @param images - RGB(A) source images, Bayer mosaics are an error
+   * @param targetTime
+   * @param gridSize - number of samples along the largest side of the images
+   * @return exp(mean(log(delta + L)))
+   */
+  template<typename SourceType>
+  float getLogAverageLuminance(const std::vector< Image<SourceType> > &images,
+                               float targetTime,
+                               std::size_t gridSize = 256) const;
+
+  /**
+   * @brief Accumulate the log-average grid of one source, for the merges that see one source at a time
+   * The grid is the grid of getLogAverageLuminance over the sources.
+   * @param image - full RGB(A) source image
+   * @param exposure - index of the source exposure
+   * @param wsum - grid accumulator of weighted radiances, created by the first call
+   * @param wdiv - grid accumulator of weights, created by the first call
+   * @param gridSize - number of samples along the largest side of the image
+   */
+  template<typename SourceType>
+  void accumulateGrid(const Image<SourceType> &image,
+                      std::size_t exposure,
+                      Image<float> &wsum,
+                      Image<float> &wdiv,
+                      std::size_t gridSize = 256) const;
+
+  /**
+   * @brief Log-average luminance of the radiance from the grid accumulators of all exposures (streaming merge)
+   * @param wsum - grid accumulator of weighted radiances
+   * @param wdiv - grid accumulator of weights
+   * @param bounds - bounds of the sources of the grid, pixel coordinates of the color stage
+   * @param targetTime
+   * @param gridSize - grid size of the accumulation
+   */
+  float getLogAverageLuminance(const Image<float> &wsum,
+                               const Image<float> &wdiv,
+                               const OfxRectI &bounds,
+                               float targetTime,
+                               std::size_t gridSize = 256) const;
+
+  /**
+   * @brief Number of exposures from which the merge is tiled
+   */
+  static constexpr std::size_t kStagingExposures = 8;
+
+  /**
+   * @brief Default staging buffer size, the L2 cache also holds the merge tables
+   */
+  static constexpr std::size_t kDefaultStagingBytes = 64 << 10;
+
+  /**
+   * @brief Width of the float tiles of half sources when the staging buffer doesn't set one
+   */
+  static constexpr std::size_t kHalfTileWidth = 256;
+
+  /**
+   * @brief Maximum relative difference accepted between a SIMD kernel and the scalar kernel
+   */
+  static constexpr double kernelTolerance = 1e-3;
   
   /**
    * @brief This function obtains the "average scene luminance" EV value 
@@ -68,6 +351,53 @@ public:
     //LV = LV = EV + log2 (ISO / 100) (LV light Value as exposure)
     //return std::log2( ((aperture * aperture)/shutter) * (iso / 100) );
   }
+
+private:
+
+  /**
+   * @brief Width of the staged tiles of a merge, 0 if the rows are merged from the sources
+   * @param nbExposures
+   * @param pixelSize - bytes of a source pixel
+   * @param width - width of the sources
+   */
+  std::size_t getTileWidth(std::size_t nbExposures, std::size_t pixelSize, std::size_t width) const;
+
+  /**
+   * @brief Row function of a merge table, the reference function in the reference mode
+   * @param lut - merge tables
+   */
+  template<typename SourceType>
+  typename MergeRow<SourceType>::Function getRowFunction(const MergeLut &lut) const
+  {
+    return _reference ? getMergeRowReferenceFunction<SourceType>(lut) : getMergeRowFunction<SourceType>(_kernel, lut);
+  }
+
+  /**
+   * @brief Merge a band of rows of Bayer mosaics
+   * Samples are merged by pairs of columns, as 2 channels pixels with the tables of the row parity.
+   * @param images
+   * @param radiance - single channel radiance mosaic
+   * @param targetTime
+   * @param yBegin - first row
+   * @param yEnd - row after the last row
+   */
+  template<typename SourceType>
+  void processMosaicRows(const std::vector< Image<SourceType> > &images, 
+                         Image<float> &radiance, 
+                         float targetTime,
+                         std::size_t yBegin,
+                         std::size_t yEnd) const;
+
+  MergeLut _lut;
+  //tables of the mosaic rows of even and odd pixel coordinates, the channel c of a table
+  //has the curves of the color at the column parity c, the channel 2 the color missing in the row
+  MergeLut _mosaicLuts[2];
+  ECfaPattern _cfaPattern = eCfaNone;
+  const ColorStage *_colorStage = nullptr;
+  EMergeKernel _kernel = getBestMergeKernel();
+  float _skipThreshold = 0.0f;
+  std::size_t _stagingBytes = kDefaultStagingBytes;
+  bool _reference = false; //reference mode of compareWithReference
 };
 
 } // namespace common
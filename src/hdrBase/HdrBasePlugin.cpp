@@ -1,9 +1,12 @@
 #include "HdrBasePlugin.hpp"
 #include "../common/RobertsonMerge.hpp"
 #include "../common/Presets.hpp"
+#include "MergeProcessor.hpp"
 #include <stdio.h>
 #include <cassert>
+#include <cmath>
 #include <algorithm>
+#include <array>
 #include <iostream>
 #include <regex>
 
@@ -37,7 +40,75 @@ HdrBasePlugin::HdrBasePlugin(OfxImageEffectHandle handle, std::size_t nbClips) :
 
 bool HdrBasePlugin::isIdentity(const OFX::IsIdentityArguments &args, OFX::Clip * &identityClip, double &identityTime)
 {
-  return false;
+  //debug output is a source image without modifications, the host can use it directly
+  if(!_debugActive->getValue() || !hasInputGroup())
+  {
+    return false;
+  }
+  
+  const std::size_t group = getOutputClipIndex();
+  if(group >= getNbInputGroup() || !isGroupConnected(group))
+  {
+    return false;
+  }
+  
+  //the output clip is float or half (getClipPreferences), an integer source is converted by a render
+  if(_srcClip[group]->getPixelDepth() != _dstClip->getPixelDepth())
+  {
+    return false;
+  }
+  
+  const OfxRangeD range = _srcClip[group]->getFrameRange();
+  const int outputIndex = _debugOutput->getValue() - 1;
+  if((outputIndex < 0) || (outputIndex > range.max - range.min))
+  {
+    //the render shows an invalid output index
+    return false;
+  }
+  
+  identityClip = _srcClip[group];
+  identityTime = range.min + outputIndex;
+  return true;
+}
+
+void HdrBasePlugin::getRegionsOfInterest(const OFX::RegionsOfInterestArguments &args, OFX::RegionOfInterestSetter &rois)
+{
+  for(std::size_t group = 0; group < getNbInputGroup(); ++group)
+  {
+    if(_srcClip[group]->isConnected())
+    {
+      rois.setRegionOfInterest(*_srcClip[group], args.regionOfInterest);
+    }
+  }
+  
+  if(_flatFieldClip->isConnected())
+  {
+    rois.setRegionOfInterest(*_flatFieldClip, args.regionOfInterest);
+  }
+}
+
+void HdrBasePlugin::getClipPreferences(OFX::ClipPreferencesSetter &clipPreferences)
+{
+  if(!OFX::getImageEffectHostDescription()->supportsMultipleClipDepths || !hasInputGroup())
+  {
+    return;
+  }
+  
+  //integer sources are merged with their code values
+  const OFX::BitDepthEnum depth = _srcClip[getFirstConnectedGroupIndex()]->getUnmappedPixelDepth();
+  
+  //radiances don't fit integer outputs, half sources give a half output
+  clipPreferences.setClipBitDepth(*_dstClip, (depth == OFX::eBitDepthHalf) ? OFX::eBitDepthHalf : OFX::eBitDepthFloat);
+  for(std::size_t group : _connectedClipIdx)
+  {
+    clipPreferences.setClipBitDepth(*_srcClip[group], depth);
+  }
+  
+  //flat-field gains above 1 need a float clip
+  if(_flatFieldClip->isConnected())
+  {
+    clipPreferences.setClipBitDepth(*_flatFieldClip, OFX::eBitDepthFloat);
+  }
 }
 
 void HdrBasePlugin::changedClip(const OFX::InstanceChangedArgs &args, const std::string &clipName)
@@ -165,35 +236,486 @@ bool HdrBasePlugin::changedTargetMetaData(const std::string &paramName)
   return false;
 }
 
-bool HdrBasePlugin::renderDebug(cameraColorCalibration::common::Image<float> &output, std::size_t groupIndex)
+template<typename SourceType>
+bool HdrBasePlugin::renderDebug(cameraColorCalibration::common::Image<float> &output, 
+                                const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources)
 {
   if(_debugActive->getValue())
   {
     std::size_t outputIndex = _debugOutput->getValue() - 1;
     
-    if(getSource(groupIndex).size() <= outputIndex)
+    if(sources.size() <= outputIndex)
     {
       output.setRed();
     }
     else
     {
       std::cout << "render [Debug]" << std::endl;
-      output.copyFrom(getSource(groupIndex)[outputIndex]);
+      cameraColorCalibration::common::Image<float> source;
+      source.convertFrom(sources[outputIndex]);
+      output.copyFrom(source);
     }
     return true;
   }
   return false;
 }
 
-bool HdrBasePlugin::loadSources()
+/**
+ * @brief Intersection of two rectangles
+ */
+static OfxRectI intersectWindow(const OfxRectI &a, const OfxRectI &b)
+{
+  OfxRectI window;
+  window.x1 = std::max(a.x1, b.x1);
+  window.y1 = std::max(a.y1, b.y1);
+  window.x2 = std::max(window.x1, std::min(a.x2, b.x2));
+  window.y2 = std::max(window.y1, std::min(a.y2, b.y2));
+  return window;
+}
+
+template<typename SourceType>
+bool HdrBasePlugin::getRenderWindowViews(const OfxRectI &renderWindow,
+                                         const cameraColorCalibration::common::Image<float> &output,
+                                         const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                                         cameraColorCalibration::common::Image<float> &outputView,
+                                         std::vector< cameraColorCalibration::common::Image<SourceType> > &sourceViews)
+{
+  const OfxRectI outputWindow = intersectWindow(renderWindow, output.getBounds());
+  
+  OfxRectI window = outputWindow;
+  for(auto const &source : sources)
+  {
+    window = intersectWindow(window, source.getBounds());
+  }
+  
+  if((window.x1 != outputWindow.x1) || (window.y1 != outputWindow.y1) || 
+     (window.x2 != outputWindow.x2) || (window.y2 != outputWindow.y2))
+  {
+    //sources don't cover the whole render window
+    outputView.setView(output, outputWindow);
+    outputView.setZero();
+  }
+  
+  if((window.x1 == window.x2) || (window.y1 == window.y2))
+  {
+    return false;
+  }
+  
+  outputView.setView(output, window);
+  sourceViews = std::vector< cameraColorCalibration::common::Image<SourceType> >(sources.size());
+  for(std::size_t i = 0; i < sources.size(); ++i)
+  {
+    sourceViews[i].setView(sources[i], window);
+  }
+  return true;
+}
+
+template<typename SourceType>
+void HdrBasePlugin::checkMergeKernel(const cameraColorCalibration::common::RobertsonMerge &merge,
+                                     const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                                     const cameraColorCalibration::common::Image<float> &radiance,
+                                     float targetTime)
+{
+  if(!_debugCheckKernel->getValue())
+  {
+    return;
+  }
+  
+  const char *kernelName = cameraColorCalibration::common::getMergeKernelName(merge.getKernel());
+  const double difference = merge.compareWithReference(sources, radiance, targetTime);
+  std::cout << "render : [check kernel] " << kernelName << " max relative difference: " << difference << std::endl;
+  
+  if(difference > cameraColorCalibration::common::RobertsonMerge::kernelTolerance)
+  {
+    this->sendMessage(OFX::Message::eMessageError, "hdrmerge.kernel.check", 
+                      std::string("Merge kernel ") + kernelName + " differs from the scalar kernel (" + std::to_string(difference) + ").");
+  }
+}
+
+template<typename SourceType>
+void HdrBasePlugin::pruneExposures(RenderContext &context,
+                                   std::size_t groupIndex,
+                                   const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                                   std::vector< cameraColorCalibration::common::Image<SourceType> > &sourceViews)
+{
+  const float pruneThreshold = static_cast<float>(_pruneThreshold->getValue());
+  if((pruneThreshold <= 0.0f) || (sources.size() < 2))
+  {
+    return;
+  }
+  
+  const std::vector<std::size_t> selection = cameraColorCalibration::common::RobertsonMerge::selectContributingExposures(sources, context.weight, pruneThreshold);
+  if(selection.size() == sources.size())
+  {
+    return;
+  }
+  std::cout << "render : [prune] merge " << selection.size() << " of " << sources.size() << " exposures" << std::endl;
+  
+  std::vector< cameraColorCalibration::common::Image<SourceType> > views(selection.size());
+  std::vector<float> exposures;
+  std::vector<std::size_t> frames;
+  std::vector<std::string> identifiers;
+  
+  for(std::size_t i = 0; i < selection.size(); ++i)
+  {
+    views[i].swap(sourceViews[selection[i]]);
+    exposures.push_back(context.getExposure(groupIndex)[selection[i]]);
+    frames.push_back(context.getFrames(groupIndex)[selection[i]]);
+    identifiers.push_back(context.getIdentifiers(groupIndex)[selection[i]]);
+  }
+  
+  sourceViews.swap(views);
+  context.getExposure(groupIndex).swap(exposures);
+  context.getFrames(groupIndex).swap(frames);
+  context.getIdentifiers(groupIndex).swap(identifiers);
+}
+
+template<typename SourceType>
+void HdrBasePlugin::renderMerge(RenderContext &context,
+                                std::size_t groupIndex,
+                                const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                                cameraColorCalibration::common::Image<float> &outputView)
 {
-  //clear process data
-  _ldrImageGroups.clear();
-  _luminances.clear();
+  //integer code values index the merge tables directly
+  const std::size_t nbCodes = cameraColorCalibration::common::getNbCodes<SourceType>();
+  const float skipThreshold = static_cast<float>(_skipThreshold->getValue());
+  
+  const RadianceCache::Key key = RadianceCache::makeKey(context.getIdentifiers(groupIndex),
+                                                        context.getExposure(groupIndex),
+                                                        context.weight,
+                                                        context.response,
+                                                        context.renderScale,
+                                                        outputView.getBounds(),
+                                                        nbCodes,
+                                                        skipThreshold);
+  
+  std::cout << "render : [merge] targetExposure: " << context.targetExposure << std::endl;
+  
+  cameraColorCalibration::common::RobertsonMerge merge;
+  merge.setSkipThreshold(skipThreshold);
+  
+  //the color stage is applied after the cache, a color change only rescales the cached radiance
+  const bool cached = _radianceCache.scaleTo(key, outputView, context.targetExposure, &context.colorStage);
+  
+  std::size_t hits, misses;
+  _radianceCache.getStatistics(hits, misses);
+  std::cout << "render : [cache] hits: " << hits << " misses: " << misses << std::endl;
+  
+  if(cached)
+  {
+    std::cout << "render : [merge] radiance from cache -- OK" << std::endl;
+    return;
+  }
+  
+  bool incremental = _incremental->getValue();
+  
+  if(incremental && _radianceCache.updateTimes(key, outputView, context.targetExposure, &context.colorStage))
+  {
+    std::cout << "render : [merge] incremental update -- OK" << std::endl;
+    return;
+  }
+  
+  std::cout << "render : [merge] kernel: " << cameraColorCalibration::common::getMergeKernelName(merge.getKernel()) << std::endl;
+  std::cout << "render : [merge] skip threshold: " << skipThreshold << std::endl;
+  merge.setColorStage(&context.colorStage);
+  merge.init(context.getExposure(groupIndex), context.weight, context.response, nbCodes);
+  
+  //the host doesn't identify the sources, or the output is tone mapped and can't be rescaled:
+  //merge straight into the output buffer, without caching
+  if(!key.isValid() || context.colorStage.isToneMapped())
+  {
+    MergeProcessor processor(merge, sources, outputView, context.targetExposure);
+    processor.process();
+    std::cout << "render : [merge] -- OK" << std::endl;
+    checkMergeKernel(merge, sources, outputView, context.targetExposure);
+    return;
+  }
+  
+  //the exposure planes of the window have to fit in the cache budget, or the plain merge is used
+  const std::size_t incrementalBytes = outputView.getWidth() * outputView.getHeight() * 3 * sizeof(float) +
+    cameraColorCalibration::common::MergeAccumulator::getByteSize(outputView.getWidth(), outputView.getHeight(), sources.size());
+  if(incremental && (incrementalBytes > RadianceCache::maxBytes))
+  {
+    std::cout << "render : [merge] incremental accumulators of " << (incrementalBytes >> 20) << "MB above the cache budget, plain merge" << std::endl;
+    incremental = false;
+  }
+  
+  //merge unscaled, the target exposure is applied when writing the output
+  cameraColorCalibration::common::Image<float> radiance(outputView.getWidth(), outputView.getHeight(), 3);
+  cameraColorCalibration::common::MergeAccumulator accumulator;
+  
+  if(incremental)
+  {
+    //keep the contribution of each exposure for the next exposure time changes
+    accumulator.init(outputView.getWidth(), outputView.getHeight(), context.getExposure(groupIndex));
+    MergeProcessor processor(outputView.getHeight(), [&](std::size_t yBegin, std::size_t yEnd)
+    {
+      accumulator.accumulateRows(merge, sources, yBegin, yEnd);
+      accumulator.finalizeRows(radiance, 1.0f, yBegin, yEnd);
+    });
+    processor.process();
+  }
+  else
+  {
+    //the cached radiance is merged without the color stage
+    merge.setColorStage(nullptr);
+    MergeProcessor processor(merge, sources, radiance, 1.0f);
+    processor.process();
+    checkMergeKernel(merge, sources, radiance, 1.0f);
+  }
+  
+  MergeProcessor scale(outputView.getHeight(), [&](std::size_t yBegin, std::size_t yEnd)
+  {
+    cameraColorCalibration::common::RobertsonMerge::scaleRows(radiance, outputView, context.targetExposure, yBegin, yEnd, &context.colorStage);
+  });
+  scale.process();
+  std::cout << "render : [merge] -- OK" << std::endl;
+  
+  _radianceCache.store(key, radiance, accumulator);
+}
+
+void HdrBasePlugin::renderGroup(RenderContext &context,
+                                std::size_t groupIndex,
+                                const OfxRectI &renderWindow,
+                                cameraColorCalibration::common::Image<float> &output)
+{
+  switch(context.getSourceDepth(groupIndex))
+  {
+    case OFX::eBitDepthUByte:
+      renderGroup(context, groupIndex, renderWindow, context.getSource<std::uint8_t>(groupIndex), output);
+      break;
+    case OFX::eBitDepthUShort:
+      renderGroup(context, groupIndex, renderWindow, context.getSource<std::uint16_t>(groupIndex), output);
+      break;
+    case OFX::eBitDepthHalf:
+      renderGroup(context, groupIndex, renderWindow, context.getSource<cameraColorCalibration::common::Half>(groupIndex), output);
+      break;
+    default:
+      renderGroup(context, groupIndex, renderWindow, context.getSource<float>(groupIndex), output);
+      break;
+  }
+}
+
+template<typename SourceType>
+void HdrBasePlugin::renderGroup(RenderContext &context,
+                                std::size_t groupIndex,
+                                const OfxRectI &renderWindow,
+                                const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                                cameraColorCalibration::common::Image<float> &output)
+{
+  //Restrict the render to the render window
+  cameraColorCalibration::common::Image<float> outputView;
+  std::vector< cameraColorCalibration::common::Image<SourceType> > sourceViews;
+  if(!getRenderWindowViews(renderWindow, output, sources, outputView, sourceViews))
+  {
+    std::cout << "render : [info] empty render window" << std::endl;
+    return;
+  }
+  
+  //Debug Render
+  if(renderDebug(outputView, sourceViews))
+  {
+    return;
+  }
+  
+  //the tone mapping is measured on all the exposures of the whole sources
+  if(context.colorStage.isToneMapped())
+  {
+    measureLogAverage(context, groupIndex, sources);
+  }
+  
+  pruneExposures(context, groupIndex, sources, sourceViews);
+  renderMerge(context, groupIndex, sourceViews, outputView);
+}
+
+template<typename SourceType>
+void HdrBasePlugin::measureLogAverage(RenderContext &context,
+                                      std::size_t groupIndex,
+                                      const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources)
+{
+  const std::size_t nbCodes = cameraColorCalibration::common::getNbCodes<SourceType>();
+  const float skipThreshold = static_cast<float>(_skipThreshold->getValue());
+  
+  const RadianceCache::Key mergeKey = RadianceCache::makeKey(context.getIdentifiers(groupIndex),
+                                                             context.getExposure(groupIndex),
+                                                             context.weight,
+                                                             context.response,
+                                                             context.renderScale,
+                                                             sources.front().getBounds(),
+                                                             nbCodes,
+                                                             skipThreshold);
+  const RadianceCache::Key key = RadianceCache::makeLogAverageKey(mergeKey, context.targetExposure, context.colorStage, context.flatFieldIdentifier);
+  
+  float logAverage;
+  if(!_radianceCache.getLogAverage(key, logAverage))
+  {
+    //subsampled pre-pass on the corrected radiance, the full radiance is never needed before the tone mapping
+    cameraColorCalibration::common::RobertsonMerge merge;
+    merge.setSkipThreshold(skipThreshold);
+    merge.setColorStage(&context.colorStage);
+    merge.init(context.getExposure(groupIndex), context.weight, context.response, nbCodes);
+    logAverage = merge.getLogAverageLuminance(sources, context.targetExposure);
+    _radianceCache.storeLogAverage(key, logAverage);
+  }
+  
+  context.colorStage.setLogAverage(logAverage);
+  std::cout << "render : [tone map] log-average luminance: " << logAverage << std::endl;
+}
+
+bool HdrBasePlugin::renderStreaming(RenderContext &context, 
+                                    std::size_t groupIndex,
+                                    const OfxRectI &renderWindow,
+                                    cameraColorCalibration::common::Image<float> &output)
+{
+  const OfxRectI window = intersectWindow(renderWindow, output.getBounds());
+  if((window.x1 == window.x2) || (window.y1 == window.y2))
+  {
+    return true;
+  }
+  
+  cameraColorCalibration::common::Image<float> outputView;
+  outputView.setView(output, window);
   
+  const OFX::BitDepthEnum depth = getInputClip(getConnectedGroupIndex(groupIndex))->getPixelDepth();
+  switch(depth)
+  {
+    case OFX::eBitDepthUByte:
+      return renderStreaming<std::uint8_t>(context, groupIndex, outputView);
+    case OFX::eBitDepthUShort:
+      return renderStreaming<std::uint16_t>(context, groupIndex, outputView);
+    case OFX::eBitDepthHalf:
+      return renderStreaming<cameraColorCalibration::common::Half>(context, groupIndex, outputView);
+    case OFX::eBitDepthFloat:
+      return renderStreaming<float>(context, groupIndex, outputView);
+    default:
+      throw std::logic_error("Unsupported source bit depth");
+  }
+}
+
+template<typename SourceType>
+bool HdrBasePlugin::renderStreaming(RenderContext &context, 
+                                    std::size_t groupIndex,
+                                    cameraColorCalibration::common::Image<float> &outputView)
+{
+  const OfxRectI window = outputView.getBounds();
+  const std::size_t height = outputView.getHeight();
+  
+  cameraColorCalibration::common::RobertsonMerge merge;
+  std::cout << "render : [merge] targetExposure: " << context.targetExposure << std::endl;
+  std::cout << "render : [merge] kernel: " << cameraColorCalibration::common::getMergeKernelName(merge.getKernel()) << std::endl;
+  merge.init(context.getExposure(groupIndex), context.weight, context.response, cameraColorCalibration::common::getNbCodes<SourceType>());
+  
+  //running accumulators
+  cameraColorCalibration::common::Image<float> wsum(outputView.getWidth(), height, 3);
+  cameraColorCalibration::common::Image<float> wdiv(outputView.getWidth(), height, 3);
+  wsum.setZero();
+  wdiv.setZero();
+  
+  //log-average grid of the tone mapping
+  cameraColorCalibration::common::Image<float> gridWsum;
+  cameraColorCalibration::common::Image<float> gridWdiv;
+  OfxRectI gridBounds = window;
+  
+  OFX::Clip *clip = getInputClip(getConnectedGroupIndex(groupIndex));
+  std::size_t start = (std::size_t)clip->getFrameRange().min;
+  
+  //fetches stay on the render thread, the host workers accumulate each source
+  const std::vector<std::size_t> &frames = context.getFrames(groupIndex);
+  for(std::size_t exposure = 0; exposure < frames.size(); ++exposure)
+  {
+    if(abort())
+    {
+      return false;
+    }
+    
+    std::cout << "render : [streaming] Image : " << start + frames[exposure] << std::endl;
+    OFX::Image *imagePtr = clip->fetchImage(start + frames[exposure]);
+    if(imagePtr == NULL)
+    {
+      std::cerr << "render : [streaming] error : can't load image " << std::endl;
+      return false;
+    }
+    
+    //the source image is released at the end of the iteration
+    const OfxPointD imageScale = imagePtr->getRenderScale();
+    cameraColorCalibration::common::Image<SourceType> source(imagePtr);
+    conformRenderScale(context.renderScale, imageScale, source);
+    const OfxRectI bounds = source.getBounds();
+    if((bounds.x1 > window.x1) || (bounds.y1 > window.y1) || (bounds.x2 < window.x2) || (bounds.y2 < window.y2))
+    {
+      throw std::logic_error("Source image doesn't cover the render window");
+    }
+    
+    if(context.colorStage.isToneMapped())
+    {
+      //the log-average grid covers the whole source, as in the merge of all the sources
+      merge.accumulateGrid(source, exposure, gridWsum, gridWdiv);
+      gridBounds = bounds;
+    }
+    
+    cameraColorCalibration::common::Image<SourceType> sourceView;
+    sourceView.setView(source, window);
+    
+    MergeProcessor accumulate(height, [&](std::size_t yBegin, std::size_t yEnd)
+    {
+      merge.accumulateRows(sourceView, exposure, wsum, wdiv, yBegin, yEnd);
+    });
+    accumulate.process();
+  }
+  
+  if(context.colorStage.isToneMapped())
+  {
+    //the sources are gone, the log-average is measured on the grid accumulators
+    merge.setColorStage(&context.colorStage);
+    const float logAverage = merge.getLogAverageLuminance(gridWsum, gridWdiv, gridBounds, context.targetExposure);
+    context.colorStage.setLogAverage(logAverage);
+    std::cout << "render : [tone map] log-average luminance: " << logAverage << std::endl;
+  }
+  
+  MergeProcessor finalize(height, [&](std::size_t yBegin, std::size_t yEnd)
+  {
+    merge.finalizeRows(wsum, wdiv, outputView, context.targetExposure, yBegin, yEnd, &context.colorStage);
+  });
+  finalize.process();
+  return true;
+}
+
+template<typename SourceType>
+void HdrBasePlugin::conformRenderScale(const OfxPointD &renderScale,
+                                       const OfxPointD &imageScale,
+                                       cameraColorCalibration::common::Image<SourceType> &source)
+{
+  const double scaleX = renderScale.x / imageScale.x;
+  const double scaleY = renderScale.y / imageScale.y;
+  
+  if((std::abs(scaleX - 1.0) < 1e-6) && (std::abs(scaleY - 1.0) < 1e-6))
+  {
+    //the host delivered the source at the render resolution
+    return;
+  }
+  
+  if((scaleX > 1.0) || (scaleY > 1.0))
+  {
+    throw std::logic_error("Source image resolution is lower than the render resolution");
+  }
+  
+  std::cout << "[load] proxy : downsample " << scaleX << ", " << scaleY << std::endl;
+  cameraColorCalibration::common::Image<SourceType> proxy;
+  proxy.downsampleFrom(source, scaleX, scaleY);
+  
+  //the full resolution image is released with the proxy variable
+  source.swap(proxy);
+}
+
+void HdrBasePlugin::loadExposures(RenderContext &context)
+{
   std::size_t nbConnectedGroup = getNbConnectedInput();
-  _ldrImageGroups = std::vector< std::vector< cameraColorCalibration::common::Image<float> > >(nbConnectedGroup);
-  _luminances = std::vector< std::vector<float> >(nbConnectedGroup);
+  context.exposures = std::vector< std::vector<float> >(nbConnectedGroup);
+  context.frames = std::vector< std::vector<std::size_t> >(nbConnectedGroup);
+  context.targetExposure = getTargetExposure();
+  
+  //the debug output shows a given source image, all the frames are needed
+  const bool draft = context.draft && !_debugActive->getValue();
   
   std::size_t groupIndex = 0;
   
@@ -209,20 +731,10 @@ bool HdrBasePlugin::loadSources()
     std::size_t start = (std::size_t)clip->getFrameRange().min;
     std::size_t last = (std::size_t)clip->getFrameRange().max;
     
-    _ldrImageGroups[groupIndex] = std::vector< cameraColorCalibration::common::Image<float> >(last - start + 1);
-    _luminances[groupIndex] = std::vector<float>(last - start + 1);
-    
-    /*
-    float targetExposure = cameraColorCalibration::common::RobertsonMerge::getExposure(_targetShutter->getValue(),
-                                                                                  _targetIso->getValue(),
-                                                                                  _targetAperture->getValue());
-    */
-    float targetExposure = _targetShutter->getValue();
+    context.exposures[groupIndex] = std::vector<float>(last - start + 1);
     
     for(std::size_t image = start; image <= last; ++image)
     {
-      std::cout << "[load] Group :  " << group << " Index : " << groupIndex << " Image :  " << image << std::endl;
-      
       /*
       float exposure = cameraColorCalibration::common::RobertsonMerge::getExposure(_shutter[group][image-start]->getValue(),
                                                                                     _iso[group][image-start]->getValue(),
@@ -232,20 +744,154 @@ bool HdrBasePlugin::loadSources()
       //std::cout << "[load]   compute EV ("<< exposure << ") ..." << std::endl;
       //float avgLuminance = std::pow(2.f, exposure - targetExposure);
       float avgLuminance = _shutter[group][image-start]->getValue();
-      std::cout << "[load]   add time ("<< avgLuminance << ") ..." << std::endl;
+      std::cout << "[load] Group :  " << group << " Image :  " << image << " time ("<< avgLuminance << ")" << std::endl;
      
-      _luminances[groupIndex][image-start] = avgLuminance;
-      
-      std::cout << "[load]   add Image ... " << std::endl;
-      OFX::Image *imagePtr = clip->fetchImage(image);
-      if(imagePtr == NULL)
+      context.exposures[groupIndex][image-start] = avgLuminance;
+    }
+    
+    //a draft merge keeps a few exposures spread over the bracket
+    const std::vector<float> times = context.exposures[groupIndex];
+    const std::size_t nbExposures = draft ? static_cast<std::size_t>(_draftExposures->getValue()) : times.size();
+    context.frames[groupIndex] = cameraColorCalibration::common::RobertsonMerge::selectSpreadExposures(times, nbExposures);
+    context.exposures[groupIndex].clear();
+    for(std::size_t frame : context.frames[groupIndex])
+    {
+      context.exposures[groupIndex].push_back(times[frame]);
+    }
+    if(context.frames[groupIndex].size() < times.size())
+    {
+      std::cout << "[load] Group :  " << group << " draft merge of " << context.frames[groupIndex].size() << " exposures" << std::endl;
+    }
+    ++groupIndex;
+  }
+}
+
+bool HdrBasePlugin::loadSources(RenderContext &context)
+{
+  loadExposures(context);
+  
+  context.sources = std::vector< std::vector< cameraColorCalibration::common::Image<float> > >(getNbConnectedInput());
+  context.sourcesUByte = std::vector< std::vector< cameraColorCalibration::common::Image<std::uint8_t> > >(getNbConnectedInput());
+  context.sourcesUShort = std::vector< std::vector< cameraColorCalibration::common::Image<std::uint16_t> > >(getNbConnectedInput());
+  context.sourcesHalf = std::vector< std::vector< cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> > >(getNbConnectedInput());
+  context.sourceDepths = std::vector<OFX::BitDepthEnum>(getNbConnectedInput(), OFX::eBitDepthFloat);
+  context.identifiers = std::vector< std::vector<std::string> >(getNbConnectedInput());
+  
+  for(std::size_t groupIndex = 0; groupIndex < getNbConnectedInput(); ++groupIndex)
+  {
+    if(!loadGroupSources(context, groupIndex))
+    {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool HdrBasePlugin::loadSources(RenderContext &context, std::size_t groupIndex)
+{
+  loadExposures(context);
+  
+  context.sources = std::vector< std::vector< cameraColorCalibration::common::Image<float> > >(getNbConnectedInput());
+  context.sourcesUByte = std::vector< std::vector< cameraColorCalibration::common::Image<std::uint8_t> > >(getNbConnectedInput());
+  context.sourcesUShort = std::vector< std::vector< cameraColorCalibration::common::Image<std::uint16_t> > >(getNbConnectedInput());
+  context.sourcesHalf = std::vector< std::vector< cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> > >(getNbConnectedInput());
+  context.sourceDepths = std::vector<OFX::BitDepthEnum>(getNbConnectedInput(), OFX::eBitDepthFloat);
+  context.identifiers = std::vector< std::vector<std::string> >(getNbConnectedInput());
+  
+  return loadGroupSources(context, groupIndex);
+}
+
+/**
+ * @brief Convert integer sources to float sources, the integer images are released
+ * @param[in,out] sources - integer sources
+ * @param[out] floatSources
+ */
+template<typename SourceType>
+static void convertSources(std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                           std::vector< cameraColorCalibration::common::Image<float> > &floatSources)
+{
+  floatSources = std::vector< cameraColorCalibration::common::Image<float> >(sources.size());
+  for(std::size_t i = 0; i < sources.size(); ++i)
+  {
+    floatSources[i].convertFrom(sources[i]);
+  }
+  sources.clear();
+}
+
+bool HdrBasePlugin::loadGroupSources(RenderContext &context, std::size_t groupIndex)
+{
+  const OFX::BitDepthEnum depth = _srcClip[getConnectedGroupIndex(groupIndex)]->getPixelDepth();
+  context.sourceDepths[groupIndex] = depth;
+  
+  bool loaded = false;
+  switch(depth)
+  {
+    case OFX::eBitDepthUByte:
+      loaded = fetchGroupSources<std::uint8_t>(context, groupIndex);
+      if(loaded && context.floatSources)
       {
-        std::cerr << "[load] error : can't load image " << std::endl;
-        return false;
+        convertSources(context.getSource<std::uint8_t>(groupIndex), context.getSource<float>(groupIndex));
+        context.sourceDepths[groupIndex] = OFX::eBitDepthFloat;
       }
-      _ldrImageGroups[groupIndex][image - start].setOfxImage(imagePtr);
+      break;
+    case OFX::eBitDepthUShort:
+      loaded = fetchGroupSources<std::uint16_t>(context, groupIndex);
+      if(loaded && context.floatSources)
+      {
+        convertSources(context.getSource<std::uint16_t>(groupIndex), context.getSource<float>(groupIndex));
+        context.sourceDepths[groupIndex] = OFX::eBitDepthFloat;
+      }
+      break;
+    case OFX::eBitDepthHalf:
+      loaded = fetchGroupSources<cameraColorCalibration::common::Half>(context, groupIndex);
+      if(loaded && context.floatSources)
+      {
+        convertSources(context.getSource<cameraColorCalibration::common::Half>(groupIndex), context.getSource<float>(groupIndex));
+        context.sourceDepths[groupIndex] = OFX::eBitDepthFloat;
+      }
+      break;
+    case OFX::eBitDepthFloat:
+      loaded = fetchGroupSources<float>(context, groupIndex);
+      break;
+    default:
+      this->sendMessage(OFX::Message::eMessageError, "hdrmerge.depth", "Unsupported source bit depth.");
+      break;
+  }
+  return loaded;
+}
+
+template<typename SourceType>
+bool HdrBasePlugin::fetchGroupSources(RenderContext &context, std::size_t groupIndex)
+{
+  const std::size_t group = getConnectedGroupIndex(groupIndex);
+  
+  OFX::Clip *clip = _srcClip[group];
+  std::size_t start = (std::size_t)clip->getFrameRange().min;
+  const std::vector<std::size_t> &frames = context.getFrames(groupIndex);
+  
+  std::vector< cameraColorCalibration::common::Image<SourceType> > &sources = context.getSource<SourceType>(groupIndex);
+  sources = std::vector< cameraColorCalibration::common::Image<SourceType> >(frames.size());
+  context.identifiers[groupIndex] = std::vector<std::string>(frames.size());
+  
+  for(std::size_t exposure = 0; exposure < frames.size(); ++exposure)
+  {
+    const std::size_t image = start + frames[exposure];
+    std::cout << "[load] Group :  " << group << " Index : " << groupIndex << " Image :  " << image << std::endl;
+    
+    OFX::Image *imagePtr = clip->fetchImage(image);
+    if(imagePtr == NULL)
+    {
+      std::cerr << "[load] error : can't load image " << std::endl;
+      return false;
     }
-    ++groupIndex;
+    
+    const OfxPointD imageScale = imagePtr->getRenderScale();
+    context.identifiers[groupIndex][exposure] = imagePtr->getUniqueIdentifier();
+    cameraColorCalibration::common::Image<SourceType> &source = sources[exposure];
+    source.setOfxImage(imagePtr);
+    
+    //merge on the reduced pixel count of a proxy render
+    conformRenderScale(context.renderScale, imageScale, source);
   }
   return true;
 }
@@ -253,7 +899,131 @@ bool HdrBasePlugin::loadSources()
 bool HdrBasePlugin::loadOutput(OFX::Image *& outputPtr, double time)
 {
   outputPtr = _dstClip->fetchImage(time);
-  return outputPtr != NULL;
+  if(outputPtr == NULL)
+  {
+    return false;
+  }
+  
+  if((outputPtr->getPixelDepth() != OFX::eBitDepthFloat) && (outputPtr->getPixelDepth() != OFX::eBitDepthHalf))
+  {
+    //the host doesn't support a float output with integer sources
+    this->sendMessage(OFX::Message::eMessageError, "hdrmerge.depth", "The output has to be float or half.");
+    delete outputPtr;
+    outputPtr = NULL;
+    return false;
+  }
+  return true;
+}
+
+bool HdrBasePlugin::loadColorStage(RenderContext &context, double time)
+{
+  double red, green, blue;
+  _whiteBalance->getValueAtTime(time, red, green, blue);
+  context.colorStage.setWhiteBalance(static_cast<float>(red), static_cast<float>(green), static_cast<float>(blue));
+  
+  std::array<float, 9> matrix;
+  for(std::size_t row = 0; row < 3; ++row)
+  {
+    double x, y, z;
+    _colorMatrix[row]->getValueAtTime(time, x, y, z);
+    matrix[row * 3] = static_cast<float>(x);
+    matrix[row * 3 + 1] = static_cast<float>(y);
+    matrix[row * 3 + 2] = static_cast<float>(z);
+  }
+  context.colorStage.setMatrix(matrix);
+  
+  context.flatField.clear();
+  context.flatFieldIdentifier.clear();
+  context.colorStage.setFlatField(nullptr);
+  if(!_flatFieldClip->isConnected())
+  {
+    return true;
+  }
+  
+  //a merge without the connected gain would be silently wrong
+  OFX::Image *imagePtr = _flatFieldClip->fetchImage(time);
+  if(imagePtr == NULL)
+  {
+    std::cerr << "[load] error : can't load flat field " << std::endl;
+    this->sendMessage(OFX::Message::eMessageError, "hdrmerge.flatfield", "Can't load the flat field image.");
+    return false;
+  }
+  
+  const OfxPointD imageScale = imagePtr->getRenderScale();
+  context.flatFieldIdentifier = imagePtr->getUniqueIdentifier();
+  switch(imagePtr->getPixelDepth())
+  {
+    case OFX::eBitDepthUByte:
+    {
+      cameraColorCalibration::common::Image<std::uint8_t> gain(imagePtr);
+      context.flatField.convertFrom(gain);
+      break;
+    }
+    case OFX::eBitDepthUShort:
+    {
+      cameraColorCalibration::common::Image<std::uint16_t> gain(imagePtr);
+      context.flatField.convertFrom(gain);
+      break;
+    }
+    case OFX::eBitDepthHalf:
+    {
+      cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> gain(imagePtr);
+      context.flatField.convertFrom(gain);
+      break;
+    }
+    case OFX::eBitDepthFloat:
+      context.flatField.setOfxImage(imagePtr);
+      break;
+    default:
+      delete imagePtr;
+      throw std::logic_error("Unsupported flat field bit depth");
+  }
+  
+  //gain pixels have to match the merged pixels
+  conformRenderScale(context.renderScale, imageScale, context.flatField);
+  context.colorStage.setFlatField(&context.flatField);
+  std::cout << "[load] flat field : " << context.flatField.getWidth() << "x" << context.flatField.getHeight() << std::endl;
+  return true;
+}
+
+void HdrBasePlugin::setOutputImage(OFX::Image *outputPtr,
+                                   const OfxRectI &renderWindow,
+                                   cameraColorCalibration::common::Image<float> &output,
+                                   cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> &halfOutput)
+{
+  if(outputPtr->getPixelDepth() != OFX::eBitDepthHalf)
+  {
+    output.setOfxImage(outputPtr);
+    return;
+  }
+  
+  //the render writes the render window in float, converted once at the end
+  halfOutput.setOfxImage(outputPtr);
+  const OfxRectI window = intersectWindow(renderWindow, halfOutput.getBounds());
+  output.createInternalBuffer(window.x2 - window.x1, window.y2 - window.y1, halfOutput.getNbChannels());
+  output.setOrigin(window.x1, window.y1);
+  output.setZero();
+}
+
+void HdrBasePlugin::writeOutputImage(const cameraColorCalibration::common::Image<float> &output,
+                                     cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> &halfOutput)
+{
+  if(halfOutput.isEmpty())
+  {
+    return;
+  }
+  
+  cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> halfView;
+  halfView.setView(halfOutput, output.getBounds());
+  
+  MergeProcessor convert(output.getHeight(), [&](std::size_t yBegin, std::size_t yEnd)
+  {
+    for(std::size_t y = yBegin; y < yEnd; ++y)
+    {
+      cameraColorCalibration::common::convertFloatToHalf(output.getPixel(0, y), halfView.getPixel(0, y), output.getWidth() * output.getNbChannels());
+    }
+  });
+  convert.process();
 }
 
 void HdrBasePlugin::updateConnectedClipIndexCollection()
@@ -524,5 +1294,14 @@ void HdrBasePlugin::reset()
   updateWeightPreset();
 }
 
+//float helpers used by the calibration render
+template bool HdrBasePlugin::renderDebug(cameraColorCalibration::common::Image<float> &, 
+                                         const std::vector< cameraColorCalibration::common::Image<float> > &);
+template bool HdrBasePlugin::getRenderWindowViews(const OfxRectI &,
+                                                  const cameraColorCalibration::common::Image<float> &,
+                                                  const std::vector< cameraColorCalibration::common::Image<float> > &,
+                                                  cameraColorCalibration::common::Image<float> &,
+                                                  std::vector< cameraColorCalibration::common::Image<float> > &);
+
 } // namespace hdrBase 
-} // namespace cameraColorCalibration
\ No newline at end of file
+} // namespace cameraColorCalibration
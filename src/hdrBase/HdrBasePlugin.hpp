@@ -2,9 +2,13 @@
 #include "ofxsImageEffect.h"
 #include "HdrBasePluginDescriber.hpp"
 #include "HdrBasePluginDefinition.hpp"
+#include "RenderContext.hpp"
+#include "RadianceCache.hpp"
 #include "../common/Image.hpp"
+#include "../common/RobertsonMerge.hpp"
 #include "../common/rgbCurve.hpp"
 #include "../common/Presets.hpp"
+#include <algorithm>
 
 namespace cameraColorCalibration {
 namespace hdrBase {
@@ -20,6 +24,7 @@ private:
   //Clips
   OFX::Clip *_dstClip = fetchClip(kOfxImageEffectOutputClipName); //Destination clip
   OFX::Clip *_srcClip[K_MAX_GROUPS]; //Sources clip groups
+  OFX::Clip *_flatFieldClip = fetchClip(kClipFlatField); //Optional flat-field gain clip
   
   //UI Groups
   OFX::GroupParam *_clipGroups[K_MAX_GROUPS];
@@ -54,9 +59,23 @@ private:
   OFX::DoubleParam *_weightGreen = fetchDoubleParam(kParamWeightGreen);
   OFX::DoubleParam *_weightBlue = fetchDoubleParam(kParamWeightBlue); 
   
+  //Performance Parameters
+  OFX::BooleanParam *_streaming = fetchBooleanParam(kParamPerformanceStreaming);
+  OFX::BooleanParam *_incremental = fetchBooleanParam(kParamPerformanceIncremental);
+  OFX::IntParam *_draftExposures = fetchIntParam(kParamPerformanceDraftExposures);
+  OFX::DoubleParam *_skipThreshold = fetchDoubleParam(kParamPerformanceSkipThreshold);
+  OFX::DoubleParam *_pruneThreshold = fetchDoubleParam(kParamPerformancePruneThreshold);
+  
+  //Color Parameters
+  OFX::Double3DParam *_whiteBalance = fetchDouble3DParam(kParamColorWhiteBalance);
+  OFX::Double3DParam *_colorMatrix[3] = {fetchDouble3DParam(kParamColorMatrixRed),
+                                         fetchDouble3DParam(kParamColorMatrixGreen),
+                                         fetchDouble3DParam(kParamColorMatrixBlue)};
+  
   //Debug Parameters
   OFX::BooleanParam *_debugActive = fetchBooleanParam(kParamDebugActive);
   OFX::IntParam *_debugOutput = fetchIntParam(kParamDebugOutput);
+  OFX::BooleanParam *_debugCheckKernel = fetchBooleanParam(kParamDebugCheckKernel);
   
   //Invalidation Parameters
   OFX::IntParam *_forceInvalidation = fetchIntParam(kParamForceInvalidation);
@@ -65,9 +84,8 @@ private:
   std::size_t _nbClips;
   std::vector<std::size_t> _connectedClipIdx;
   
-  //Process Data
-  std::vector< std::vector< cameraColorCalibration::common::Image<float> > > _ldrImageGroups;
-  std::vector< std::vector<float> > _luminances;
+  //Last unscaled radiance, a target exposure change doesn't need a merge
+  RadianceCache _radianceCache;
 
 public:
   
@@ -79,6 +97,7 @@ public:
   
   /**
    * @brief Override isIdentity method
+   * The debug output is a source image of the output group, when the source has the output bit depth.
    * @param[in] args
    * @param[in,out] identityClip
    * @param[in,out] identityTime
@@ -86,6 +105,21 @@ public:
    */
   virtual bool isIdentity(const OFX::IsIdentityArguments &args, OFX::Clip * &identityClip, double &identityTime);
 
+  /**
+   * @brief Override getRegionsOfInterest method
+   * The merge is a per pixel operation, sources are needed on the output region only.
+   * @param[in] args
+   * @param[out] rois
+   */
+  virtual void getRegionsOfInterest(const OFX::RegionsOfInterestArguments &args, OFX::RegionOfInterestSetter &rois);
+
+  /**
+   * @brief Override getClipPreferences method
+   * The output is half for half sources and float otherwise, sources keep the bit depth of the first connected source.
+   * @param[out] clipPreferences
+   */
+  virtual void getClipPreferences(OFX::ClipPreferencesSetter &clipPreferences);
+
   /**
    * @brief Override changedClip method
    * @param[in] args
@@ -115,23 +149,228 @@ public:
   bool changedTargetMetaData(const std::string &paramName);
   
   /**
-   * 
-   * @param groupIndex
-   * @return 
+   * @brief Output a source image without modifications if asked in debug parameters
+   * Integer sources are normalized to [0, 1].
+   * @param output
+   * @param sources - source images of the output group
+   * @return debug render is active
+   */
+  template<typename SourceType>
+  bool renderDebug(cameraColorCalibration::common::Image<float> &output, 
+                   const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources);
+  
+  /**
+   * @brief Restrict the output and the sources to the part of the render window covered by all of them
+   * Output pixels of the render window not covered by the sources are set to zero.
+   * @param[in] renderWindow
+   * @param[in] output
+   * @param[in] sources
+   * @param[out] outputView
+   * @param[out] sourceViews
+   * @return false if there is nothing to render
+   */
+  template<typename SourceType>
+  bool getRenderWindowViews(const OfxRectI &renderWindow,
+                            const cameraColorCalibration::common::Image<float> &output,
+                            const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                            cameraColorCalibration::common::Image<float> &outputView,
+                            std::vector< cameraColorCalibration::common::Image<SourceType> > &sourceViews);
+  
+  /**
+   * @brief Compare the merge kernel output with the scalar reference if asked in debug parameters
+   * @param merge - merge operator used for the render
+   * @param sources - merged images
+   * @param radiance - merge result
+   * @param targetTime
+   */
+  template<typename SourceType>
+  void checkMergeKernel(const cameraColorCalibration::common::RobertsonMerge &merge,
+                        const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                        const cameraColorCalibration::common::Image<float> &radiance,
+                        float targetTime);
+  
+  /**
+   * @brief Drop the exposures of a group contributing under the prune threshold, before the merge
+   * The contributions are measured on the whole sources, the same exposures are kept for all the render windows.
+   * @param[in,out] context - render data, the exposures, frames and identifiers of the group are pruned
+   * @param[in] groupIndex - index of the group in the render context
+   * @param[in] sources - group sources
+   * @param[in,out] sourceViews - views of the group sources on the output window
+   */
+  template<typename SourceType>
+  void pruneExposures(RenderContext &context,
+                      std::size_t groupIndex,
+                      const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                      std::vector< cameraColorCalibration::common::Image<SourceType> > &sourceViews);
+  
+  /**
+   * @brief Measure the log-average luminance of the tone mapping on a grid of the whole sources
+   * Every tile of a frame gets the same value, kept with the radiance cache for the next tiles.
+   * @param[in,out] context - render data, the log-average is set in the color stage
+   * @param[in] groupIndex - index of the group in the render context
+   * @param[in] sources - group sources, all the exposures
+   */
+  template<typename SourceType>
+  void measureLogAverage(RenderContext &context,
+                         std::size_t groupIndex,
+                         const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources);
+  
+  /**
+   * @brief Merge a group into the output, reusing the last unscaled radiance when only the target exposure changed
+   * With the incremental merge, a change of exposure times only updates the changed exposures.
+   * @param[in] context - render data with sources, exposures, weight and response
+   * @param[in] groupIndex - index of the group in the render context
+   * @param[in] sources - views of the group sources on the output window
+   * @param[out] outputView - merge result scaled to the target exposure
+   */
+  template<typename SourceType>
+  void renderMerge(RenderContext &context,
+                   std::size_t groupIndex,
+                   const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                   cameraColorCalibration::common::Image<float> &outputView);
+  
+  /**
+   * @brief Render a loaded group in the output: debug output or merge
+   * Integer sources are merged with their code values, without conversion.
+   * @param[in] context - render data with sources, exposures, weight and response
+   * @param[in] groupIndex - index of the group in the render context
+   * @param[in] renderWindow
+   * @param[out] output
+   */
+  void renderGroup(RenderContext &context,
+                   std::size_t groupIndex,
+                   const OfxRectI &renderWindow,
+                   cameraColorCalibration::common::Image<float> &output);
+  
+  /**
+   * @brief Render group sources with a given data type in the output
+   * @param[in] context - render data with exposures, weight and response
+   * @param[in] groupIndex - index of the group in the render context
+   * @param[in] renderWindow
+   * @param[in] sources - source images of the group
+   * @param[out] output
+   */
+  template<typename SourceType>
+  void renderGroup(RenderContext &context,
+                   std::size_t groupIndex,
+                   const OfxRectI &renderWindow,
+                   const std::vector< cameraColorCalibration::common::Image<SourceType> > &sources,
+                   cameraColorCalibration::common::Image<float> &output);
+  
+  /**
+   * @brief Merge a group fetching one source image at a time
+   * Only two accumulators and one source image are in memory.
+   * @param[in] context - render data with exposures, weight and response
+   * @param[in] groupIndex - index of the group in the render context
+   * @param[in] renderWindow
+   * @param[out] output
+   * @return false if an image can't be fetched or the render is aborted
+   */
+  bool renderStreaming(RenderContext &context, 
+                       std::size_t groupIndex,
+                       const OfxRectI &renderWindow,
+                       cameraColorCalibration::common::Image<float> &output);
+  
+  /**
+   * @brief Streaming merge of the sources with a given data type
+   * @param[in] context - render data with exposures, weight and response
+   * @param[in] groupIndex - index of the group in the render context
+   * @param[out] outputView - output restricted to the render window
+   * @return false if an image can't be fetched or the render is aborted
+   */
+  template<typename SourceType>
+  bool renderStreaming(RenderContext &context, 
+                       std::size_t groupIndex,
+                       cameraColorCalibration::common::Image<float> &outputView);
+  
+  /**
+   * @brief Box downsample a source image delivered at a higher resolution than the render
+   * @param[in] renderScale - resolution of the render
+   * @param[in] imageScale - resolution of the source image
+   * @param[in,out] source - replaced by its proxy, the host image is released
    */
-  bool renderDebug(cameraColorCalibration::common::Image<float> &output, std::size_t groupIndex = 0);
+  template<typename SourceType>
+  void conformRenderScale(const OfxPointD &renderScale,
+                          const OfxPointD &imageScale,
+                          cameraColorCalibration::common::Image<SourceType> &source);
   
   /**
-   * 
+   * @brief Read the exposure times of all connected groups, without fetching images
+   * A draft render only keeps a few exposures spread over each group.
+   * @param[out] context - render data
    */
-  bool loadSources();
+  void loadExposures(RenderContext &context);
+  
+  /**
+   * @brief Fetch the source images and their exposure times of all connected groups
+   * @param[out] context - render data
+   * @return false if an image can't be fetched
+   */
+  bool loadSources(RenderContext &context);
+  
+  /**
+   * @brief Fetch the source images of one group and the exposure times of all connected groups
+   * Sources of the other groups stay empty in the context.
+   * @param[out] context - render data
+   * @param[in] groupIndex - index of the group in the render context
+   * @return false if an image can't be fetched
+   */
+  bool loadSources(RenderContext &context, std::size_t groupIndex);
+  
+  /**
+   * @brief Fetch the source images of one connected group at the bit depth of its clip
+   * @param[in,out] context - render data, sources already sized to the connected groups
+   * @param[in] groupIndex - index of the group in the render context
+   * @return false if an image can't be fetched or its bit depth isn't supported
+   */
+  bool loadGroupSources(RenderContext &context, std::size_t groupIndex);
+  
+  /**
+   * @brief Fetch the source images of one connected group with a given data type
+   * @param[in,out] context - render data, sources already sized to the connected groups
+   * @param[in] groupIndex - index of the group in the render context
+   * @return false if an image can't be fetched
+   */
+  template<typename SourceType>
+  bool fetchGroupSources(RenderContext &context, std::size_t groupIndex);
   
   /**
    * @brief load output image pointer
+   * The merge writes float or half radiances, other output bit depths are an error.
    * @param outputPtr
    */
   bool loadOutput(OFX::Image *& outputPtr, double time);
   
+  /**
+   * @brief Read the color parameters and fetch the flat-field gain image of the merge output
+   * The flat-field gain is converted to float and conformed to the render scale.
+   * @param[in,out] context - render data with the render scale, gets the color stage
+   * @param[in] time - render time
+   * @return false if the flat-field clip is connected but its image can't be fetched
+   */
+  bool loadColorStage(RenderContext &context, double time);
+  
+  /**
+   * @brief Float image the render writes to
+   * A float output is used directly, a half output gets a float buffer on the render window.
+   * @param[in] outputPtr - loaded output image, released with the output images
+   * @param[in] renderWindow
+   * @param[out] output - float image of the render
+   * @param[out] halfOutput - half output image, empty for a float output
+   */
+  void setOutputImage(OFX::Image *outputPtr,
+                      const OfxRectI &renderWindow,
+                      cameraColorCalibration::common::Image<float> &output,
+                      cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> &halfOutput);
+  
+  /**
+   * @brief Convert the float render to the half output, nothing to do for a float output
+   * @param[in] output - float image of the render
+   * @param[in,out] halfOutput
+   */
+  void writeOutputImage(const cameraColorCalibration::common::Image<float> &output,
+                        cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> &halfOutput);
+  
   /**
    * @brief Update collection of connected clip indexes
    */
@@ -242,37 +481,33 @@ public:
   void reset();
   
   
-  std::vector< std::vector< cameraColorCalibration::common::Image<float> > >& getAllSources()
+  /**
+   * @brief Index of the clip group rendered in the output
+   */
+  virtual std::size_t getOutputClipIndex()
   {
-    return _ldrImageGroups;
+    return getFirstConnectedGroupIndex();
   }
   
-  std::vector< cameraColorCalibration::common::Image<float> >& getSource(std::size_t groupIndex = 0)
+  double getTargetExposure() const
   {
-    assert(groupIndex < getNbInputGroup());
-    return _ldrImageGroups[groupIndex];
+    return _targetShutter->getValue();
   }
   
-  std::vector< std::vector<float> >& getAllExposure()
+  bool isStreamingMerge() const
   {
-    return _luminances;
+    return _streaming->getValue() && !_debugActive->getValue();
   }
   
-  std::vector<float>& getExposure(std::size_t groupIndex = 0)
+  OFX::Clip* getInputClip(std::size_t groupIndex = 0)
   {
     assert(groupIndex < getNbInputGroup());
-    return _luminances[groupIndex];
-  }
-  
-  double getTargetExposure() const
-  {
-    return _targetShutter->getValue();
+    return _srcClip[groupIndex];
   }
   
-  OFX::Clip* getInputClip(std::size_t groupIndex = 0)
+  OFX::Clip* getFlatFieldClip()
   {
-    assert(groupIndex < getNbInputGroup());
-    return _srcClip[groupIndex];
+    return _flatFieldClip;
   }
   
   std::size_t getNbInputGroup()
@@ -300,6 +535,17 @@ public:
     return _connectedClipIdx[position];
   }
   
+  /**
+   * @brief Index in the render context of a connected clip
+   * @param[in] clipIndex
+   */
+  std::size_t getConnectedGroupPosition(std::size_t clipIndex) const
+  {
+    auto it = std::find(_connectedClipIdx.begin(), _connectedClipIdx.end(), clipIndex);
+    assert(it != _connectedClipIdx.end());
+    return it - _connectedClipIdx.begin();
+  }
+  
   bool isGroupConnected(std::size_t groupIndex) const
   {
     return _srcClip[groupIndex]->isConnected();
@@ -20,6 +20,7 @@
 
 //Clip
 #define kClip(I) std::to_string(I + 1)
+#define kClipFlatField "FlatField"
 
 
 //Source Group Parameters
@@ -74,11 +75,31 @@
 #define kParamWeightBlue "weightBlue"
 
 
+//Performance Group
+#define kParamGroupPerformance "groupPerformance"
+
+#define kParamPerformanceStreaming "performanceStreaming"
+#define kParamPerformanceIncremental "performanceIncremental"
+#define kParamPerformanceDraftExposures "performanceDraftExposures"
+#define kParamPerformanceSkipThreshold "performanceSkipThreshold"
+#define kParamPerformancePruneThreshold "performancePruneThreshold"
+
+
+//Color Group
+#define kParamGroupColor "groupColor"
+
+#define kParamColorWhiteBalance "colorWhiteBalance"
+#define kParamColorMatrixRed "colorMatrixRed"
+#define kParamColorMatrixGreen "colorMatrixGreen"
+#define kParamColorMatrixBlue "colorMatrixBlue"
+
+
 //Debug Group
 #define kParamGroupDebug "groupDebug"
 
 #define kParamDebugActive "debugActive"
 #define kParamDebugOutput "debugOutput"
+#define kParamDebugCheckKernel "debugCheckKernel"
 
 
 //Invalidation Parameters
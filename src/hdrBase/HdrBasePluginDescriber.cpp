@@ -21,15 +21,24 @@ void describeClip(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context, st
     
     srcClip->addSupportedComponent(OFX::ePixelComponentRGBA);
     srcClip->setTemporalClipAccess(true);
-    srcClip->setSupportsTiles(false);
+    srcClip->setSupportsTiles(true);
     srcClip->setIsMask(false);
     srcClip->setOptional(group > 0);
   }
   
+  //Flat-field gain clip
+  OFX::ClipDescriptor *flatFieldClip = desc.defineClip(kClipFlatField);
+  flatFieldClip->setLabel("Flat Field");
+  flatFieldClip->addSupportedComponent(OFX::ePixelComponentRGBA);
+  flatFieldClip->addSupportedComponent(OFX::ePixelComponentAlpha);
+  flatFieldClip->setSupportsTiles(true);
+  flatFieldClip->setIsMask(false);
+  flatFieldClip->setOptional(true);
+  
   //Output clip
   OFX::ClipDescriptor *dstClip = desc.defineClip(kOfxImageEffectOutputClipName);
   dstClip->addSupportedComponent(OFX::ePixelComponentRGBA);
-  dstClip->setSupportsTiles(false);
+  dstClip->setSupportsTiles(true);
 }
   
 OFX::GroupParamDescriptor* describeInputsGroup(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context, std::size_t nbClips)
@@ -382,6 +391,115 @@ OFX::GroupParamDescriptor* describeWeightGroup(OFX::ImageEffectDescriptor& desc,
   return groupWeight;
 }
 
+OFX::GroupParamDescriptor* describePerformanceGroup(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context)
+{
+  //Performance group
+  OFX::GroupParamDescriptor *groupPerformance = desc.defineGroupParam(kParamGroupPerformance);
+  groupPerformance->setLabel("Performance");
+  groupPerformance->setAsTab();
+
+  {
+    OFX::BooleanParamDescriptor *param = desc.defineBooleanParam(kParamPerformanceStreaming);
+    param->setLabel("Streaming Merge");
+    param->setHint("Fetch and merge one source image at a time. Memory holds two accumulators and one source instead of all the sources.");
+    param->setDefault(false);
+    param->setAnimates(false);
+    param->setEvaluateOnChange(false);
+    param->setParent(*groupPerformance);
+  }
+  
+  {
+    OFX::IntParamDescriptor *param = desc.defineIntParam(kParamPerformanceDraftExposures);
+    param->setLabel("Draft Exposures");
+    param->setHint("Number of exposures merged when the host asks for a draft render, spread over the bracket. The final render merges all the exposures.");
+    param->setDefault(3);
+    param->setRange(1, K_MAX_IMAGES_PER_GROUP);
+    param->setDisplayRange(1, 8);
+    param->setAnimates(false);
+    param->setEvaluateOnChange(false);
+    param->setParent(*groupPerformance);
+  }
+  
+  {
+    OFX::DoubleParamDescriptor *param = desc.defineDoubleParam(kParamPerformanceSkipThreshold);
+    param->setLabel("Skip Threshold");
+    param->setHint("Skip the black and saturated exposures of each pixel: samples weighted under this fraction of the maximum weight are not merged. 0 merges all the exposures. The streaming and incremental merges merge all the exposures.");
+    param->setDefault(0);
+    param->setRange(0, 1);
+    param->setIncrement(0.001);
+    param->setDisplayRange(0, 0.1);
+    param->setAnimates(false);
+    param->setEvaluateOnChange(true);
+    param->setParent(*groupPerformance);
+  }
+  
+  {
+    OFX::DoubleParamDescriptor *param = desc.defineDoubleParam(kParamPerformancePruneThreshold);
+    param->setLabel("Prune Threshold");
+    param->setHint("Drop the exposures contributing under this fraction of the total merge weight, measured on a subsampled histogram of each source. 0 merges all the exposures. The streaming merge merges all the exposures.");
+    param->setDefault(0);
+    param->setRange(0, 1);
+    param->setIncrement(0.001);
+    param->setDisplayRange(0, 0.2);
+    param->setAnimates(false);
+    param->setEvaluateOnChange(true);
+    param->setParent(*groupPerformance);
+  }
+  
+  {
+    OFX::BooleanParamDescriptor *param = desc.defineBooleanParam(kParamPerformanceIncremental);
+    param->setLabel("Incremental Merge");
+    param->setHint("Keep the contribution of each exposure, a change of exposure time only updates this exposure. Memory holds one RGB buffer per exposure, windows above the 512 MB cache budget use the plain merge. The skip threshold is not applied.");
+    param->setDefault(false);
+    param->setAnimates(false);
+    param->setEvaluateOnChange(false);
+    param->setParent(*groupPerformance);
+  }
+  
+  return groupPerformance;
+}
+
+OFX::GroupParamDescriptor* describeColorGroup(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context)
+{
+  //Color group
+  OFX::GroupParamDescriptor *groupColor = desc.defineGroupParam(kParamGroupColor);
+  groupColor->setLabel("Color");
+  groupColor->setAsTab();
+
+  {
+    OFX::Double3DParamDescriptor *param = desc.defineDouble3DParam(kParamColorWhiteBalance);
+    param->setLabel("White Balance");
+    param->setHint("Multipliers of the merged red, green and blue radiances, applied after the flat-field gain of the Flat Field clip.");
+    param->setDimensionLabels("r", "g", "b");
+    param->setDefault(1, 1, 1);
+    param->setRange(0, 0, 0, 100, 100, 100);
+    param->setDisplayRange(0, 0, 0, 4, 4, 4);
+    param->setAnimates(true);
+    param->setEvaluateOnChange(true);
+    param->setParent(*groupColor);
+  }
+  
+  //Color matrix, one parameter per output channel
+  const char *matrixNames[3] = {kParamColorMatrixRed, kParamColorMatrixGreen, kParamColorMatrixBlue};
+  const char *matrixLabels[3] = {"Matrix Red", "Matrix Green", "Matrix Blue"};
+  
+  for(std::size_t row = 0; row < 3; ++row)
+  {
+    OFX::Double3DParamDescriptor *param = desc.defineDouble3DParam(matrixNames[row]);
+    param->setLabel(matrixLabels[row]);
+    param->setHint("Row of the 3x3 color matrix applied to the white balanced radiance: coefficients of the red, green and blue inputs of this output channel.");
+    param->setDimensionLabels("r", "g", "b");
+    param->setDefault((row == 0) ? 1 : 0, (row == 1) ? 1 : 0, (row == 2) ? 1 : 0);
+    param->setRange(-100, -100, -100, 100, 100, 100);
+    param->setDisplayRange(-2, -2, -2, 2, 2, 2);
+    param->setAnimates(true);
+    param->setEvaluateOnChange(true);
+    param->setParent(*groupColor);
+  }
+  
+  return groupColor;
+}
+
 OFX::GroupParamDescriptor* describeDebugGroup(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context)
 {
   //Debug group
@@ -408,6 +526,15 @@ OFX::GroupParamDescriptor* describeDebugGroup(OFX::ImageEffectDescriptor& desc,
     param->setEvaluateOnChange(true);
     param->setParent(*groupDebug);
   }
+
+  {
+    OFX::BooleanParamDescriptor *param = desc.defineBooleanParam(kParamDebugCheckKernel);
+    param->setLabel("Check Merge Kernel");
+    param->setHint("Compare the SIMD merge kernel with the scalar reference kernel after each merge.");
+    param->setDefault(false);
+    param->setEvaluateOnChange(true);
+    param->setParent(*groupDebug);
+  }
   
   return groupDebug;
 }
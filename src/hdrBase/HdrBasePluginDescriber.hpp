@@ -10,6 +10,8 @@ OFX::GroupParamDescriptor* describeInputsGroup(OFX::ImageEffectDescriptor& desc,
 OFX::GroupParamDescriptor* describeTargetGroup(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context);
 OFX::GroupParamDescriptor* describeResponseGroup(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context, bool allowEditing = true);
 OFX::GroupParamDescriptor* describeWeightGroup(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context);
+OFX::GroupParamDescriptor* describePerformanceGroup(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context);
+OFX::GroupParamDescriptor* describeColorGroup(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context);
 OFX::GroupParamDescriptor* describeDebugGroup(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context);
 void describeInvalidation(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context);
 
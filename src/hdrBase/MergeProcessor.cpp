@@ -0,0 +1,68 @@
+#include "MergeProcessor.hpp"
+#include <algorithm>
+#include <iostream>
+
+
+namespace cameraColorCalibration {
+namespace hdrBase {
+
+//Minimum number of rows merged by a band
+static const std::size_t kMinRowsPerBand = 16;
+
+//Bands per CPU, for load balancing
+static const std::size_t kBandsPerCPU = 4;
+
+MergeProcessor::MergeProcessor(std::size_t height, const BandFunction &function) :
+  _height(height),
+  _function(function),
+  _failed(false)
+{}
+
+void MergeProcessor::process()
+{
+  const std::size_t nbCPUs = OFX::MultiThread::getNumCPUs();
+  _nbBands = computeNbBands(_height, nbCPUs);
+  
+  _exception = nullptr;
+  _failed = false;
+  multiThread(static_cast<unsigned int>(std::min(_nbBands, nbCPUs)));
+  
+  //exceptions can't cross the host thread callback, they are rethrown on the calling thread
+  if(_exception)
+  {
+    std::rethrow_exception(_exception);
+  }
+}
+
+void MergeProcessor::multiThreadFunction(unsigned int threadId, unsigned int nThreads)
+{
+  //interleaved bands, neighbour bands go to different threads
+  for(std::size_t band = threadId; band < _nbBands && !_failed; band += nThreads)
+  {
+    const std::size_t yBegin = (band * _height) / _nbBands;
+    const std::size_t yEnd = ((band + 1) * _height) / _nbBands;
+    try
+    {
+      _function(yBegin, yEnd);
+    }
+    catch(...)
+    {
+      std::lock_guard<std::mutex> lock(_exceptionMutex);
+      if(!_exception)
+      {
+        _exception = std::current_exception();
+      }
+      _failed = true;
+    }
+  }
+}
+
+std::size_t MergeProcessor::computeNbBands(std::size_t height, std::size_t nbCPUs)
+{
+  const std::size_t maxBands = std::max<std::size_t>(1, height / kMinRowsPerBand);
+  const std::size_t wantedBands = std::max<std::size_t>(1, nbCPUs * kBandsPerCPU);
+  return std::min(maxBands, wantedBands);
+}
+
+} // namespace hdrBase 
+} // namespace cameraColorCalibration
@@ -0,0 +1,92 @@
+#pragma once
+#include "ofxsImageEffect.h"
+#include "ofxsMultiThread.h"
+#include "../common/Image.hpp"
+#include "../common/RobertsonMerge.hpp"
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+
+namespace cameraColorCalibration {
+namespace hdrBase {
+
+/**
+ * @brief Merge split in row bands, executed by the host thread pool
+ */
+class MergeProcessor : public OFX::MultiThread::Processor
+{
+public:
+
+  //Work on the rows [yBegin, yEnd)
+  typedef std::function<void(std::size_t yBegin, std::size_t yEnd)> BandFunction;
+
+  /**
+   * @brief MergeProcessor constructor, merge all the images
+   * @param[in] merge - initialized merge operator
+   * @param[in] images - source images
+   * @param[out] radiance - merge result
+   * @param[in] targetTime
+   */
+  template<typename SourceType>
+  MergeProcessor(const cameraColorCalibration::common::RobertsonMerge &merge,
+                 const std::vector< cameraColorCalibration::common::Image<SourceType> > &images,
+                 cameraColorCalibration::common::Image<float> &radiance,
+                 float targetTime) :
+    _height(images.front().getHeight()),
+    _function([&merge, &images, &radiance, targetTime](std::size_t yBegin, std::size_t yEnd)
+              {
+                merge.processRows(images, radiance, targetTime, yBegin, yEnd);
+              }),
+    _failed(false)
+  {}
+
+  /**
+   * @brief MergeProcessor constructor, any row based merge step
+   * @param[in] height - number of rows
+   * @param[in] function - band function, called concurrently on different bands
+   */
+  MergeProcessor(std::size_t height, const BandFunction &function);
+
+  /**
+   * @brief Process all bands using the host threads
+   * An exception thrown by a band is caught on its host thread and rethrown here,
+   * once all the threads are done.
+   */
+  void process();
+
+  /**
+   * @brief Override multiThreadFunction method
+   * @param[in] threadId
+   * @param[in] nThreads
+   */
+  virtual void multiThreadFunction(unsigned int threadId, unsigned int nThreads);
+
+  std::size_t getNbBands() const
+  {
+    return _nbBands;
+  }
+
+  /**
+   * @brief Number of bands for an image height and a number of CPUs
+   * Several bands per CPU balance the load, bands too small waste the per band setup.
+   * @param[in] height
+   * @param[in] nbCPUs
+   */
+  static std::size_t computeNbBands(std::size_t height, std::size_t nbCPUs);
+
+private:
+  std::size_t _height;
+  BandFunction _function;
+  std::size_t _nbBands = 1;
+  
+  //First exception thrown by a band, the other bands are skipped
+  std::exception_ptr _exception;
+  std::atomic<bool> _failed;
+  std::mutex _exceptionMutex;
+};
+
+} // namespace hdrBase 
+} // namespace cameraColorCalibration
@@ -0,0 +1,276 @@
+#include "RadianceCache.hpp"
+#include "MergeProcessor.hpp"
+#include "../common/RobertsonMerge.hpp"
+#include "../common/Hash.hpp"
+#include <algorithm>
+#include <iostream>
+
+
+namespace cameraColorCalibration {
+namespace hdrBase {
+
+constexpr std::size_t RadianceCache::maxBytes;
+
+bool RadianceCache::Key::isSameMerge(const Key &other) const
+{
+  return valid && other.valid && (mergeHash == other.mergeHash) && (times.size() == other.times.size());
+}
+
+bool RadianceCache::Key::operator==(const Key &other) const
+{
+  return isSameMerge(other) && (times == other.times);
+}
+
+RadianceCache::Key RadianceCache::makeKey(const std::vector<std::string> &sources,
+                                          const std::vector<float> &times,
+                                          const cameraColorCalibration::common::rgbCurve &weight,
+                                          const cameraColorCalibration::common::rgbCurve &response,
+                                          const OfxPointD &renderScale,
+                                          const OfxRectI &window,
+                                          std::size_t nbCodes,
+                                          float skipThreshold)
+{
+  Key key;
+  key.times = times;
+  key.valid = !sources.empty() && 
+              std::none_of(sources.begin(), sources.end(), [](const std::string &identifier) { return identifier.empty(); });
+
+  cameraColorCalibration::common::Hash hash;
+  hash.add(sources);
+  for(std::size_t channel = 0; channel < 3; ++channel)
+  {
+    hash.add(weight.getCurve(channel));
+    hash.add(response.getCurve(channel));
+  }
+  hash.add(static_cast<float>(renderScale.x));
+  hash.add(static_cast<float>(renderScale.y));
+  hash.add(window.x1);
+  hash.add(window.y1);
+  hash.add(window.x2);
+  hash.add(window.y2);
+  hash.add(nbCodes);
+  hash.add(skipThreshold);
+  key.mergeHash = hash.getValue();
+  return key;
+}
+
+RadianceCache::Key RadianceCache::makeLogAverageKey(const Key &merge,
+                                                    float targetTime,
+                                                    const cameraColorCalibration::common::ColorStage &colorStage,
+                                                    const std::string &flatField)
+{
+  Key key = merge;
+  //a flat-field the host doesn't identify can't be cached
+  key.valid = merge.valid && (!colorStage.hasFlatField() || !flatField.empty());
+
+  cameraColorCalibration::common::Hash hash;
+  hash.add(&merge.mergeHash, sizeof(merge.mergeHash));
+  hash.add(targetTime);
+  for(float value : colorStage.getColorMatrix())
+  {
+    hash.add(value);
+  }
+  hash.add(flatField);
+  key.mergeHash = hash.getValue();
+  return key;
+}
+
+bool RadianceCache::getLogAverage(const Key &key, float &logAverage) const
+{
+  OFX::MultiThread::AutoMutex lock(_mutex);
+  if(!key.isValid() || !(key == _logAverageKey))
+  {
+    return false;
+  }
+  logAverage = _logAverage;
+  return true;
+}
+
+void RadianceCache::storeLogAverage(const Key &key, float logAverage)
+{
+  if(!key.isValid())
+  {
+    return;
+  }
+
+  OFX::MultiThread::AutoMutex lock(_mutex);
+  _logAverageKey = key;
+  _logAverage = logAverage;
+}
+
+std::size_t RadianceCache::Entry::getByteSize() const
+{
+  return radiance.getSize() * sizeof(float) + accumulator.getByteSize();
+}
+
+bool RadianceCache::scaleTo(const Key &key,
+                            cameraColorCalibration::common::Image<float> &output,
+                            float targetTime,
+                            const cameraColorCalibration::common::ColorStage *colorStage)
+{
+  if(!key.isValid())
+  {
+    return false;
+  }
+
+  //the shared reference keeps the entry alive if a concurrent render releases it
+  EntryPtr entry;
+  {
+    OFX::MultiThread::AutoMutex lock(_mutex);
+
+    auto it = std::find_if(_entries.begin(), _entries.end(), [&key](const EntryPtr &cached) { return cached->key == key; });
+    if(it == _entries.end())
+    {
+      ++_misses;
+      return false;
+    }
+    ++_hits;
+    _entries.splice(_entries.begin(), _entries, it);
+    entry = *it;
+  }
+
+  MergeProcessor scale(output.getHeight(), [&](std::size_t yBegin, std::size_t yEnd)
+  {
+    cameraColorCalibration::common::RobertsonMerge::scaleRows(entry->radiance, output, targetTime, yBegin, yEnd, colorStage);
+  });
+  scale.process();
+  return true;
+}
+
+bool RadianceCache::updateTimes(const Key &key,
+                                cameraColorCalibration::common::Image<float> &output,
+                                float targetTime,
+                                const cameraColorCalibration::common::ColorStage *colorStage)
+{
+  if(!key.isValid())
+  {
+    return false;
+  }
+
+  //an invalid exposure time needs a full merge
+  if(std::any_of(key.times.begin(), key.times.end(), [](float time) { return time <= 0.0f; }))
+  {
+    return false;
+  }
+
+  //take the entry out of the cache, the update writes its buffers
+  EntryPtr entry;
+  {
+    OFX::MultiThread::AutoMutex lock(_mutex);
+
+    auto it = std::find_if(_entries.begin(), _entries.end(), [&key](const EntryPtr &cached)
+    {
+      return !cached->accumulator.isEmpty() && key.isSameMerge(cached->key);
+    });
+    //a concurrent scale still reads the entry
+    if((it == _entries.end()) || (it->use_count() > 1))
+    {
+      return false;
+    }
+    entry = *it;
+    _bytes -= entry->getByteSize();
+    _entries.erase(it);
+  }
+
+  cameraColorCalibration::common::MergeAccumulator &accumulator = entry->accumulator;
+  const std::size_t height = accumulator.getHeight();
+
+  for(std::size_t exposure = 0; exposure < key.times.size(); ++exposure)
+  {
+    if(key.times[exposure] == accumulator.getTimes()[exposure])
+    {
+      continue;
+    }
+    std::cout << "render : [merge] update exposure " << exposure << " time: " << key.times[exposure] << std::endl;
+
+    MergeProcessor update(height, [&](std::size_t yBegin, std::size_t yEnd)
+    {
+      accumulator.updateTimeRows(exposure, key.times[exposure], yBegin, yEnd);
+    });
+    update.process();
+    accumulator.setTime(exposure, key.times[exposure]);
+  }
+
+  MergeProcessor finalize(height, [&](std::size_t yBegin, std::size_t yEnd)
+  {
+    accumulator.finalizeRows(entry->radiance, 1.0f, yBegin, yEnd);
+    cameraColorCalibration::common::RobertsonMerge::scaleRows(entry->radiance, output, targetTime, yBegin, yEnd, colorStage);
+  });
+  finalize.process();
+
+  entry->key = key;
+  OFX::MultiThread::AutoMutex lock(_mutex);
+  insert(entry);
+  return true;
+}
+
+void RadianceCache::store(const Key &key, cameraColorCalibration::common::Image<float> &radiance)
+{
+  cameraColorCalibration::common::MergeAccumulator accumulator;
+  store(key, radiance, accumulator);
+}
+
+void RadianceCache::store(const Key &key, 
+                          cameraColorCalibration::common::Image<float> &radiance,
+                          cameraColorCalibration::common::MergeAccumulator &accumulator)
+{
+  if(!key.isValid())
+  {
+    return;
+  }
+
+  EntryPtr entry = std::make_shared<Entry>();
+  entry->key = key;
+  entry->radiance.swap(radiance);
+  entry->accumulator.swap(accumulator);
+
+  OFX::MultiThread::AutoMutex lock(_mutex);
+  insert(entry);
+}
+
+void RadianceCache::insert(const EntryPtr &entry)
+{
+  //one entry per window, it replaces a merge of the same window with other exposure times
+  _entries.remove_if([this, &entry](const EntryPtr &cached)
+  {
+    if(!cached->key.isSameMerge(entry->key))
+    {
+      return false;
+    }
+    _bytes -= cached->getByteSize();
+    return true;
+  });
+
+  const std::size_t bytes = entry->getByteSize();
+  if(bytes > maxBytes)
+  {
+    std::cout << "render : [cache] window of " << (bytes >> 20) << "MB above the cache budget, not kept" << std::endl;
+    return;
+  }
+
+  _entries.push_front(entry);
+  _bytes += bytes;
+  while(_bytes > maxBytes)
+  {
+    _bytes -= _entries.back()->getByteSize();
+    _entries.pop_back();
+  }
+}
+
+void RadianceCache::getStatistics(std::size_t &hits, std::size_t &misses) const
+{
+  OFX::MultiThread::AutoMutex lock(_mutex);
+  hits = _hits;
+  misses = _misses;
+}
+
+void RadianceCache::clear()
+{
+  OFX::MultiThread::AutoMutex lock(_mutex);
+  _entries.clear();
+  _bytes = 0;
+  _logAverageKey = Key();
+}
+
+} // namespace hdrBase
+} // namespace cameraColorCalibration
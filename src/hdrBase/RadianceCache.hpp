@@ -0,0 +1,200 @@
+#pragma once
+#include "ofxsImageEffect.h"
+#include "ofxsMultiThread.h"
+#include "../common/ColorStage.hpp"
+#include "../common/Image.hpp"
+#include "../common/MergeAccumulator.hpp"
+#include "../common/rgbCurve.hpp"
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace cameraColorCalibration {
+namespace hdrBase {
+
+/**
+ * @brief Unscaled radiances (merged with a target time of 1) of the last rendered windows of a plugin instance
+ * The radiance only depends on the sources, their exposure times and the merge functions,
+ * a change of the target exposure alone is served by a scale pass.
+ * Each render window (tile) is an entry, the least recently used entries are released
+ * above maxBytes.
+ */
+class RadianceCache
+{
+public:
+
+  /**
+   * @brief Everything the unscaled radiance depends on
+   * Source identifiers, merge function contents, render scale and window are hashed, exposure times
+   * are kept apart for the incremental merge.
+   */
+  struct Key
+  {
+    std::uint64_t mergeHash = 0;
+    std::vector<float> times;
+    bool valid = false; //the host identifies all the source images
+
+    bool isValid() const
+    {
+      return valid;
+    }
+
+    /**
+     * @brief Same sources, merge functions and window, exposure times may differ
+     * @param other
+     */
+    bool isSameMerge(const Key &other) const;
+
+    bool operator==(const Key &other) const;
+  };
+
+  /**
+   * @brief Memory budget of the cached radiances and accumulators of an instance
+   */
+  static constexpr std::size_t maxBytes = std::size_t(512) << 20;
+
+  /**
+   * @brief Build the key of a merge
+   * @param[in] sources - host unique identifier of each source image
+   * @param[in] times - exposure time of each source image
+   * @param[in] weight - weight function
+   * @param[in] response - response function
+   * @param[in] renderScale - resolution of the window
+   * @param[in] window - merged pixels
+   * @param[in] nbCodes - number of code values of integer sources, 0 for float sources
+   * @param[in] skipThreshold - merge skip threshold, 0 if all the exposures are merged
+   */
+  static Key makeKey(const std::vector<std::string> &sources,
+                     const std::vector<float> &times,
+                     const cameraColorCalibration::common::rgbCurve &weight,
+                     const cameraColorCalibration::common::rgbCurve &response,
+                     const OfxPointD &renderScale,
+                     const OfxRectI &window,
+                     std::size_t nbCodes,
+                     float skipThreshold);
+
+  /**
+   * @brief Build the key of the log-average luminance of the tone mapping
+   * @param[in] merge - key of the merge over the full sources
+   * @param[in] targetTime
+   * @param[in] colorStage - color corrections measured by the log-average
+   * @param[in] flatField - host unique identifier of the flat-field image, empty without flat-field
+   */
+  static Key makeLogAverageKey(const Key &merge,
+                               float targetTime,
+                               const cameraColorCalibration::common::ColorStage &colorStage,
+                               const std::string &flatField);
+
+  /**
+   * @brief Cached log-average luminance of the tone mapping
+   * @param[in] key - key of makeLogAverageKey
+   * @param[out] logAverage
+   * @return false if the key doesn't match
+   */
+  bool getLogAverage(const Key &key, float &logAverage) const;
+
+  /**
+   * @brief Replace the cached log-average luminance
+   * @param[in] key - key of makeLogAverageKey
+   * @param[in] logAverage
+   */
+  void storeLogAverage(const Key &key, float logAverage);
+
+  /**
+   * @brief Write the cached radiance scaled to a target time if the key matches
+   * @param[in] key
+   * @param[out] output - same dimensions as the cached radiance
+   * @param[in] targetTime
+   * @param[in] colorStage - color corrections of the output, null for none
+   * @return false on cache miss
+   * Hits and misses are counted. The scale runs without the lock, on a shared reference to the entry.
+   */
+  bool scaleTo(const Key &key,
+               cameraColorCalibration::common::Image<float> &output,
+               float targetTime,
+               const cameraColorCalibration::common::ColorStage *colorStage = nullptr);
+
+  /**
+   * @brief Update the cached accumulators to the exposure times of the key and write the radiance scaled to a target time
+   * Only the exposures with a different time are updated. The entry is taken out of the cache
+   * during the update, it fails if a concurrent render still reads the entry.
+   * @param[in] key
+   * @param[out] output - same dimensions as the cached radiance
+   * @param[in] targetTime
+   * @param[in] colorStage - color corrections of the output, null for none
+   * @return false if there is no accumulator for the same merge
+   */
+  bool updateTimes(const Key &key,
+                   cameraColorCalibration::common::Image<float> &output,
+                   float targetTime,
+                   const cameraColorCalibration::common::ColorStage *colorStage = nullptr);
+
+  /**
+   * @brief Add the radiance of a window, without copy
+   * An entry above maxBytes isn't kept.
+   * @param[in] key
+   * @param[in,out] radiance - unscaled radiance, released
+   */
+  void store(const Key &key, cameraColorCalibration::common::Image<float> &radiance);
+
+  /**
+   * @brief Add the radiance of a window and the accumulators it comes from, without copy
+   * An entry above maxBytes isn't kept.
+   * @param[in] key
+   * @param[in,out] radiance - unscaled radiance, released
+   * @param[in,out] accumulator - accumulators of the merge, released
+   */
+  void store(const Key &key, 
+             cameraColorCalibration::common::Image<float> &radiance,
+             cameraColorCalibration::common::MergeAccumulator &accumulator);
+
+  /**
+   * @brief Release all the cached radiances
+   */
+  void clear();
+
+  /**
+   * @brief Lookup counters since the plugin instance creation
+   * @param[out] hits
+   * @param[out] misses
+   */
+  void getStatistics(std::size_t &hits, std::size_t &misses) const;
+
+private:
+
+  /**
+   * @brief Radiance of a window, not modified while it is in the cache
+   */
+  struct Entry
+  {
+    Key key;
+    cameraColorCalibration::common::Image<float> radiance;
+    cameraColorCalibration::common::MergeAccumulator accumulator; //only kept for incremental merges
+
+    std::size_t getByteSize() const;
+  };
+
+  typedef std::shared_ptr<Entry> EntryPtr;
+
+  /**
+   * @brief Add an entry in front and release the least recently used entries above maxBytes
+   * The entry replaces the one of the same merge with other exposure times.
+   * The mutex has to be locked.
+   * @param[in] entry
+   */
+  void insert(const EntryPtr &entry);
+
+  mutable OFX::MultiThread::Mutex _mutex;
+  std::list<EntryPtr> _entries; //most recently used first
+  std::size_t _bytes = 0;
+  Key _logAverageKey;
+  float _logAverage = 0.f;
+  std::size_t _hits = 0;
+  std::size_t _misses = 0;
+};
+
+} // namespace hdrBase
+} // namespace cameraColorCalibration
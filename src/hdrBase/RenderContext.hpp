@@ -0,0 +1,129 @@
+#pragma once
+#include "HdrBasePluginDefinition.hpp"
+#include "../common/ColorStage.hpp"
+#include "../common/Image.hpp"
+#include "../common/rgbCurve.hpp"
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace cameraColorCalibration {
+namespace hdrBase {
+
+/**
+ * @brief Data of a single render
+ * Owned by the render call, so concurrent renders on one instance don't share any state.
+ */
+class RenderContext
+{
+public:
+
+  //Source images of each connected group, in the vector of their bit depth
+  std::vector< std::vector< cameraColorCalibration::common::Image<float> > > sources;
+  std::vector< std::vector< cameraColorCalibration::common::Image<std::uint8_t> > > sourcesUByte;
+  std::vector< std::vector< cameraColorCalibration::common::Image<std::uint16_t> > > sourcesUShort;
+  std::vector< std::vector< cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> > > sourcesHalf;
+  
+  //Bit depth of the source images of each connected group
+  std::vector<OFX::BitDepthEnum> sourceDepths;
+  
+  //Integer and half sources are converted to float sources while loading (calibration)
+  bool floatSources = false;
+  
+  //Host unique identifier of each source image
+  std::vector< std::vector<std::string> > identifiers;
+  
+  //Frame of each source image, from the first frame of its clip
+  std::vector< std::vector<std::size_t> > frames;
+  
+  //Exposure time of each source image
+  std::vector< std::vector<float> > exposures;
+  
+  //Merge functions
+  cameraColorCalibration::common::rgbCurve weight = cameraColorCalibration::common::rgbCurve(K_QUANTIZATION);
+  cameraColorCalibration::common::rgbCurve response = cameraColorCalibration::common::rgbCurve(K_QUANTIZATION);
+  
+  //Resolution of the render, sources are conformed to it
+  OfxPointD renderScale = {1.0, 1.0};
+  
+  //Host asked for a draft render, only a few exposures are merged
+  bool draft = false;
+  
+  //Target exposure time
+  float targetExposure = 0.5f;
+  
+  //Flat-field gain image, conformed to the render scale, empty if the clip isn't connected
+  cameraColorCalibration::common::Image<float> flatField;
+  
+  //Host unique identifier of the flat-field image
+  std::string flatFieldIdentifier;
+  
+  //Color corrections of the merge output, applied after the radiance cache
+  cameraColorCalibration::common::ColorStage colorStage;
+  
+  /**
+   * @brief Source images of all the groups with a given data type
+   */
+  template<typename SourceType>
+  std::vector< std::vector< cameraColorCalibration::common::Image<SourceType> > >& getSources();
+  
+  template<typename SourceType = float>
+  std::vector< cameraColorCalibration::common::Image<SourceType> >& getSource(std::size_t groupIndex = 0)
+  {
+    assert(groupIndex < getSources<SourceType>().size());
+    return getSources<SourceType>()[groupIndex];
+  }
+  
+  OFX::BitDepthEnum getSourceDepth(std::size_t groupIndex = 0) const
+  {
+    assert(groupIndex < sourceDepths.size());
+    return sourceDepths[groupIndex];
+  }
+  
+  std::vector<std::string>& getIdentifiers(std::size_t groupIndex = 0)
+  {
+    assert(groupIndex < identifiers.size());
+    return identifiers[groupIndex];
+  }
+  
+  std::vector<std::size_t>& getFrames(std::size_t groupIndex = 0)
+  {
+    assert(groupIndex < frames.size());
+    return frames[groupIndex];
+  }
+  
+  std::vector<float>& getExposure(std::size_t groupIndex = 0)
+  {
+    assert(groupIndex < exposures.size());
+    return exposures[groupIndex];
+  }
+};
+
+template<>
+inline std::vector< std::vector< cameraColorCalibration::common::Image<float> > >& RenderContext::getSources<float>()
+{
+  return sources;
+}
+
+template<>
+inline std::vector< std::vector< cameraColorCalibration::common::Image<std::uint8_t> > >& RenderContext::getSources<std::uint8_t>()
+{
+  return sourcesUByte;
+}
+
+template<>
+inline std::vector< std::vector< cameraColorCalibration::common::Image<std::uint16_t> > >& RenderContext::getSources<std::uint16_t>()
+{
+  return sourcesUShort;
+}
+
+template<>
+inline std::vector< std::vector< cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> > >& RenderContext::getSources<cameraColorCalibration::common::Half>()
+{
+  return sourcesHalf;
+}
+
+} // namespace hdrBase 
+} // namespace cameraColorCalibration
@@ -21,13 +21,60 @@ HdrCalibPlugin::HdrCalibPlugin(OfxImageEffectHandle handle, std::size_t nbClips)
 
 void HdrCalibPlugin::getFramesNeeded(const OFX::FramesNeededArguments &args, OFX::FramesNeededSetter &frames)
 {
-  //(!) TODO get only needed frames when user don't want calculate response (a merge)
+  if(!_wantCalculateResponse)
+  {
+    //a merge only needs the output group
+    const int outputClipIndex = _hdrOutputIndex->getValue() - 1;
+    if((outputClipIndex >= 0) && isGroupConnected(outputClipIndex))
+    {
+      frames.setFramesNeeded(*getInputClip(outputClipIndex), getInputClip(outputClipIndex)->getFrameRange());
+    }
+    return;
+  }
+  
+  //the calibration needs all groups
   for(std::size_t group = 0; group < getNbConnectedInput(); ++group)
   {
     frames.setFramesNeeded(*getInputClip(getConnectedGroupIndex(group)), getInputClip(getConnectedGroupIndex(group))->getFrameRange());
   }
 }
 
+bool HdrCalibPlugin::isIdentity(const OFX::IsIdentityArguments &args, OFX::Clip * &identityClip, double &identityTime)
+{
+  if(_wantCalculateResponse)
+  {
+    return false;
+  }
+  return HdrBasePlugin::isIdentity(args, identityClip, identityTime);
+}
+
+void HdrCalibPlugin::getRegionsOfInterest(const OFX::RegionsOfInterestArguments &args, OFX::RegionOfInterestSetter &rois)
+{
+  if(!_wantCalculateResponse)
+  {
+    //a merge only needs the output group
+    const int outputClipIndex = _hdrOutputIndex->getValue() - 1;
+    const OfxRectD empty = {0, 0, 0, 0};
+    for(std::size_t group = 0; group < getNbConnectedInput(); ++group)
+    {
+      const std::size_t clipIndex = getConnectedGroupIndex(group);
+      rois.setRegionOfInterest(*getInputClip(clipIndex), (int(clipIndex) == outputClipIndex) ? args.regionOfInterest : empty);
+    }
+    if(getFlatFieldClip()->isConnected())
+    {
+      rois.setRegionOfInterest(*getFlatFieldClip(), args.regionOfInterest);
+    }
+    return;
+  }
+  
+  //the calibration uses every pixel of every group
+  for(std::size_t group = 0; group < getNbConnectedInput(); ++group)
+  {
+    OFX::Clip *clip = getInputClip(getConnectedGroupIndex(group));
+    rois.setRegionOfInterest(*clip, clip->getRegionOfDefinition(args.time));
+  }
+}
+
 void HdrCalibPlugin::render(const OFX::RenderArguments &args)
 {
   std::cout << "render : [info] time: " << args.time << std::endl;
@@ -52,13 +99,30 @@ void HdrCalibPlugin::render(const OFX::RenderArguments &args)
     return;
   }
   
-  std::size_t groupIndex = getConnectedGroupIndex(outputClipIndex);
+  std::size_t groupIndex = getConnectedGroupPosition(outputClipIndex);
   std::cout << "Group Index : " << groupIndex << std::endl;
   
+  //User want calculate response (only one render takes the request)
+  const bool calibrate = _wantCalculateResponse.exchange(false);
+  
+  //Streaming merge, sources are fetched one by one during the merge (not for a calibration)
+  if(isStreamingMerge() && !calibrate)
+  {
+    renderStreamingMerge(args, groupIndex);
+    return;
+  }
+  
+  //a merge only loads the output group
   std::cout << "render : [load] sources"  << std::endl;
-  if(!loadSources())
+  cameraColorCalibration::hdrBase::RenderContext context;
+  context.renderScale = args.renderScale;
+  context.draft = args.renderQualityDraft && !calibrate;
+  //the calibration works on float sources
+  context.floatSources = calibrate;
+  if(!(calibrate ? loadSources(context) : loadSources(context, groupIndex)))
   {
     std::cerr << "render : [error] impossible to load sources" << std::endl;
+    _wantCalculateResponse = _wantCalculateResponse || calibrate;
     return;
   }
   
@@ -74,61 +138,121 @@ void HdrCalibPlugin::render(const OFX::RenderArguments &args)
     std::cout << "render : [output clip] is NULL" << std::endl;
     return;
   }
-  cameraColorCalibration::common::Image<float> output(outputPtr);
-  
-  //Debug Render
-  if(renderDebug(output, groupIndex))
-  {
-    return;
-  }
+  cameraColorCalibration::common::Image<float> output;
+  cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> halfOutput;
+  setOutputImage(outputPtr, args.renderWindow, output, halfOutput);
   
   //Process Data
-  cameraColorCalibration::common::rgbCurve weight(K_QUANTIZATION);
-  cameraColorCalibration::common::rgbCurve response(K_QUANTIZATION);
-  
-  getWeightFunction(weight);
-  response.setLinear();
+  getWeightFunction(context.weight);
+  context.response.setLinear();
 
-  //User want calculate response
-  if(_wantCalculateResponse)
+  if(calibrate)
   {
-    _wantCalculateResponse = false;
-
+    //Restrict the render to the render window
+    cameraColorCalibration::common::Image<float> outputView;
+    std::vector< cameraColorCalibration::common::Image<float> > sources;
+    if(!getRenderWindowViews(args.renderWindow, output, context.getSource(groupIndex), outputView, sources))
+    {
+      std::cout << "render : [info] empty render window" << std::endl;
+      return;
+    }
+    
     std::cout << "render : [calibration]" << std::endl;
     cameraColorCalibration::common::RobertsonCalibrate calibration;
     
-    calibration.process(getAllSources(), getAllExposure(), weight, response);
+    calibration.process(context.sources, context.exposures, context.weight, context.response);
     std::cout << "render : [calibration] -- OK" << std::endl;
 
     std::cout << "render : [Display Response]" << std::endl;
-    setResponseFunctionKeyFrames(response);
+    setResponseFunctionKeyFrames(context.response);
     std::cout << "render : [Display Response] -- OK" << std::endl;
     
-    output.copyFrom(calibration.getRadiance(groupIndex));
+    //Debug Render, after the calibration
+    if(renderDebug(outputView, sources))
+    {
+      writeOutputImage(output, halfOutput);
+      return;
+    }
+    
+    //radiance buffer starts at the first pixel of the sources
+    const OfxRectI sourceBounds = context.getSource(groupIndex).front().getBounds();
+    const OfxRectI window = outputView.getBounds();
+    OfxRectI radianceWindow;
+    radianceWindow.x1 = window.x1 - sourceBounds.x1;
+    radianceWindow.y1 = window.y1 - sourceBounds.y1;
+    radianceWindow.x2 = window.x2 - sourceBounds.x1;
+    radianceWindow.y2 = window.y2 - sourceBounds.y1;
+    
+    cameraColorCalibration::common::Image<float> radianceView;
+    radianceView.setView(calibration.getRadiance(groupIndex), radianceWindow);
+    outputView.copyFrom(radianceView);
+    writeOutputImage(output, halfOutput);
     return;
   }
 
   if(hasResponseKeyFrames())
   {
-    getResponseFunctionFromKeyFrames(response);
+    getResponseFunctionFromKeyFrames(context.response);
   }
 
   std::cout << "render : [merge]" << std::endl;
-  cameraColorCalibration::common::RobertsonMerge merge;
-  cameraColorCalibration::common::Image<float> hdrImage(getSource(groupIndex).front().getWidth(), getSource(groupIndex).front().getHeight(), 3);
-
-  std::cout << "render : [merge] targetExposure: " << getTargetExposure() << std::endl;
-  merge.process(getSource(groupIndex), 
-                getExposure(groupIndex), 
-                weight,
-                response,
-                hdrImage, 
-                getTargetExposure());
-  output.copyFrom(hdrImage);
-  
+  if(!loadColorStage(context, args.time))
+  {
+    std::cerr << "render : [error] impossible to load the flat field" << std::endl;
+    return;
+  }
+  renderGroup(context, groupIndex, args.renderWindow, output);
+  writeOutputImage(output, halfOutput);
 }
 
 
+void HdrCalibPlugin::renderStreamingMerge(const OFX::RenderArguments &args, std::size_t groupIndex)
+{
+  cameraColorCalibration::hdrBase::RenderContext context;
+  context.renderScale = args.renderScale;
+  context.draft = args.renderQualityDraft;
+  loadExposures(context);
+  
+  std::cout << "render : [output] fetch"  << std::endl;
+  OFX::Image *outputPtr;
+  if(!loadOutput(outputPtr, args.time))
+  {
+    std::cout << "render : [output clip] is NULL" << std::endl;
+    return;
+  }
+  cameraColorCalibration::common::Image<float> output;
+  cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> halfOutput;
+  setOutputImage(outputPtr, args.renderWindow, output, halfOutput);
+  
+  getWeightFunction(context.weight);
+  context.response.setLinear();
+  if(hasResponseKeyFrames())
+  {
+    getResponseFunctionFromKeyFrames(context.response);
+  }
+  
+  std::cout << "render : [merge] streaming" << std::endl;
+  
+  try
+  {
+    if(!loadColorStage(context, args.time))
+    {
+      std::cerr << "render : [error] impossible to load the flat field" << std::endl;
+      return;
+    }
+    if(!renderStreaming(context, groupIndex, args.renderWindow, output))
+    {
+      std::cerr << "render : [error] streaming merge failed" << std::endl;
+      return;
+    }
+    writeOutputImage(output, halfOutput);
+  }
+  catch(std::exception &e)
+  {
+    this->sendMessage(OFX::Message::eMessageError, "hdrcalib.render", e.what());
+  }
+}
+
 void HdrCalibPlugin::changedClip(const OFX::InstanceChangedArgs &args, const std::string &clipName)
 {
   if(args.reason != OFX::InstanceChangeReason::eChangeTime)
@@ -3,6 +3,7 @@
 #include "HdrCalibPluginFactory.hpp"
 #include "HdrCalibPluginDefinition.hpp"
 #include "../hdrBase/HdrBasePlugin.hpp"
+#include <atomic>
 
 
 namespace cameraColorCalibration {
@@ -25,7 +26,7 @@ private:
   OFX::DoubleParam *_algorithmThreshold = fetchDoubleParam(kParamAlgorithmThreshold);
   
   //User want to calculate the response
-  bool _wantCalculateResponse = false;
+  std::atomic<bool> _wantCalculateResponse{false};
   
 public:
   
@@ -42,12 +43,36 @@ public:
   */
   virtual void getFramesNeeded(const OFX::FramesNeededArguments &args, OFX::FramesNeededSetter &frames);
   
+  /**
+   * @brief Override isIdentity method
+   * A pending calibration needs a render, even with the debug output.
+   * @param[in] args
+   * @param[in,out] identityClip
+   * @param[in,out] identityTime
+   */
+  virtual bool isIdentity(const OFX::IsIdentityArguments &args, OFX::Clip * &identityClip, double &identityTime);
+  
+  /**
+   * @brief Override getRegionsOfInterest method
+   * The calibration needs the whole sources, a merge only the output region.
+   * @param[in] args
+   * @param[out] rois
+   */
+  virtual void getRegionsOfInterest(const OFX::RegionsOfInterestArguments &args, OFX::RegionOfInterestSetter &rois);
+  
   /**
    * @brief Override render method
    * @param[in] args
    */
   virtual void render(const OFX::RenderArguments &args);
   
+  /**
+   * @brief Merge the output group fetching one source image at a time
+   * @param[in] args
+   * @param[in] groupIndex - index of the output group in the render context
+   */
+  void renderStreamingMerge(const OFX::RenderArguments &args, std::size_t groupIndex);
+  
   /**
    * @brief Override changedClip method
    * @param[in] args
@@ -66,6 +91,14 @@ public:
    * @brief Update Output Index Range 
    */
   void updateOutputIndexRange();
+  
+  /**
+   * @brief Override getOutputClipIndex method
+   */
+  virtual std::size_t getOutputClipIndex()
+  {
+    return _hdrOutputIndex->getValue() - 1;
+  }
 };
 
 } // namespace hdrCalibration
@@ -31,16 +31,19 @@ void HdrCalibPluginFactory::describe(OFX::ImageEffectDescriptor& desc)
   //Supported pixel depths
   desc.addSupportedBitDepth(OFX::eBitDepthUByte);
   desc.addSupportedBitDepth(OFX::eBitDepthUShort);
+  desc.addSupportedBitDepth(OFX::eBitDepthHalf);
   desc.addSupportedBitDepth(OFX::eBitDepthFloat);
 
   //Flags
   desc.setSingleInstance(false);
   desc.setHostFrameThreading(false);
+  desc.setRenderThreadSafety(OFX::eRenderFullySafe);
   desc.setSupportsMultiResolution(true);
-  desc.setSupportsTiles(false);
+  desc.setSupportsTiles(true);
   desc.setTemporalClipAccess(true);
   desc.setRenderTwiceAlways(false);
   desc.setSupportsMultipleClipPARs(false);
+  desc.setSupportsMultipleClipDepths(true); //float output of integer sources
 }
 
 void HdrCalibPluginFactory::describeInContext(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context)
@@ -118,6 +121,12 @@ void HdrCalibPluginFactory::describeInContext(OFX::ImageEffectDescriptor& desc,
   //Response group
   cameraColorCalibration::hdrBase::describeResponseGroup(desc, context, false);
   
+  //Performance group
+  cameraColorCalibration::hdrBase::describePerformanceGroup(desc, context);
+  
+  //Color group
+  cameraColorCalibration::hdrBase::describeColorGroup(desc, context);
+  
   //Debug group
   cameraColorCalibration::hdrBase::describeDebugGroup(desc, context);
   
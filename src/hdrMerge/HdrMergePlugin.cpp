@@ -20,6 +20,26 @@ void HdrMergePlugin::getFramesNeeded(const OFX::FramesNeededArguments &args, OFX
   frames.setFramesNeeded(*getInputClip(), getInputClip()->getFrameRange());
 }
 
+void HdrMergePlugin::getRegionsOfInterest(const OFX::RegionsOfInterestArguments &args, OFX::RegionOfInterestSetter &rois)
+{
+  if(_outputMode->getValue() != eOutputModeToneMapped)
+  {
+    cameraColorCalibration::hdrBase::HdrBasePlugin::getRegionsOfInterest(args, rois);
+    return;
+  }
+  
+  //every tile measures the log-average luminance on the same whole sources
+  for(std::size_t group = 0; group < getNbConnectedInput(); ++group)
+  {
+    OFX::Clip *clip = getInputClip(getConnectedGroupIndex(group));
+    rois.setRegionOfInterest(*clip, clip->getRegionOfDefinition(args.time));
+  }
+  if(getFlatFieldClip()->isConnected())
+  {
+    rois.setRegionOfInterest(*getFlatFieldClip(), getFlatFieldClip()->getRegionOfDefinition(args.time));
+  }
+}
+
 void HdrMergePlugin::render(const OFX::RenderArguments &args)
 {
   std::cout << "render : [info] time: " << args.time << std::endl;
@@ -36,11 +56,26 @@ void HdrMergePlugin::render(const OFX::RenderArguments &args)
 
   try
   {
-    std::cout << "render : load source ..." << std::endl;
-    if(!loadSources())
+    cameraColorCalibration::hdrBase::RenderContext context;
+    context.renderScale = args.renderScale;
+    context.draft = args.renderQualityDraft;
+    
+    //Streaming merge, sources are fetched one by one during the merge
+    const bool streaming = isStreamingMerge();
+    
+    if(streaming)
     {
-      std::cerr << "render : [error] impossible to load sources" << std::endl;
-      return;
+      std::cout << "render : load exposures ..." << std::endl;
+      loadExposures(context);
+    }
+    else
+    {
+      std::cout << "render : load source ..." << std::endl;
+      if(!loadSources(context))
+      {
+        std::cerr << "render : [error] impossible to load sources" << std::endl;
+        return;
+      }
     }
 
     if(abort())
@@ -56,43 +91,54 @@ void HdrMergePlugin::render(const OFX::RenderArguments &args)
       return;
     }
     
-    cameraColorCalibration::common::Image<float> output(outputPtr);
+    cameraColorCalibration::common::Image<float> output;
+    cameraColorCalibration::common::Image<cameraColorCalibration::common::Half> halfOutput;
+    setOutputImage(outputPtr, args.renderWindow, output, halfOutput);
+    
+    std::cout << "render : [merge]" << std::endl;
 
-    //Debug Render
-    if(renderDebug(output))
+    getWeightFunction(context.weight);
+    getResponseFunction(context.response);
+    if(!loadColorStage(context, args.time))
     {
+      std::cerr << "render : [error] impossible to load the flat field" << std::endl;
       return;
     }
+    loadToneMap(context, args.time);
     
-    std::cout << "render : initialize output HDR ..." << std::endl;
-    cameraColorCalibration::common::Image<float> hdrImage(getSource().front().getWidth(), getSource().front().getHeight(), 3);
-
+    if(streaming)
     {
-      std::cout << "render : [merge]" << std::endl;
-     
-      cameraColorCalibration::common::RobertsonMerge merge;
-      cameraColorCalibration::common::rgbCurve weight(K_QUANTIZATION);
-      cameraColorCalibration::common::rgbCurve response(K_QUANTIZATION);
-
-      getWeightFunction(weight);
-      getResponseFunction(response);
-      
-      std::cout << "render : [merge] targetExposure: " << getTargetExposure() << std::endl;
-
-      merge.process(getSource(), getExposure(), weight, response, hdrImage, getTargetExposure());
+      if(!renderStreaming(context, 0, args.renderWindow, output))
+      {
+        std::cerr << "render : [error] streaming merge failed" << std::endl;
+        return;
+      }
+      writeOutputImage(output, halfOutput);
       std::cout << "render : [merge] -- OK" << std::endl;
+      return;
     }
-
-
-
-    std::cout << "render : HDR" << std::endl;
-    output.copyFrom(hdrImage);
+    
+    //Debug render or merge, restricted to the render window
+    renderGroup(context, 0, args.renderWindow, output);
+    writeOutputImage(output, halfOutput);
   }
   catch(std::exception &e)
   {
     this->sendMessage(OFX::Message::eMessageError, "hdrmerge.render", e.what());
   }
 }
+void HdrMergePlugin::loadToneMap(cameraColorCalibration::hdrBase::RenderContext &context, double time)
+{
+  if(_outputMode->getValue() != eOutputModeToneMapped)
+  {
+    context.colorStage.disableToneMap();
+    return;
+  }
+  
+  context.colorStage.setToneMap(static_cast<float>(_outputExposure->getValueAtTime(time)),
+                                static_cast<float>(_outputWhitePoint->getValueAtTime(time)));
+}
+
 /*
 void HdrMergePlugin::changedClip(const OFX::InstanceChangedArgs &args, const std::string &clipName)
 {
@@ -13,6 +13,14 @@ namespace hdrMerge {
  */
 class HdrMergePlugin : public cameraColorCalibration::hdrBase::HdrBasePlugin 
 {
+private:
+  //(!) Don't delete these, OFX::ImageEffect is managing them
+  
+  //Output Parameters
+  OFX::ChoiceParam *_outputMode = fetchChoiceParam(kParamOutputMode);
+  OFX::DoubleParam *_outputExposure = fetchDoubleParam(kParamOutputExposure);
+  OFX::DoubleParam *_outputWhitePoint = fetchDoubleParam(kParamOutputWhitePoint);
+  
 public:
   
   /**
@@ -28,11 +36,29 @@ public:
   */
   virtual void getFramesNeeded(const OFX::FramesNeededArguments &args, OFX::FramesNeededSetter &frames);
 
+  /**
+   * @brief Override getRegionsOfInterest method
+   * The tone mapped preview needs the whole sources for its log-average luminance.
+   * @param[in] args
+   * @param[out] rois
+   */
+  virtual void getRegionsOfInterest(const OFX::RegionsOfInterestArguments &args, OFX::RegionOfInterestSetter &rois);
+
   /**
    * @brief Override render method
    * @param[in] args
    */
   virtual void render(const OFX::RenderArguments &args);
+  
+private:
+  
+  /**
+   * @brief Enable the tone mapping of the color stage in the tone mapped preview mode
+   * The log-average luminance is measured by the merge, on the whole sources.
+   * @param[in,out] context - render data
+   * @param[in] time - render time
+   */
+  void loadToneMap(cameraColorCalibration::hdrBase::RenderContext &context, double time);
 };
 
 } // namespace hdrMerge 
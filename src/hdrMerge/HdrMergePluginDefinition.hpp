@@ -4,4 +4,20 @@
  * Plugin Parameters definition
  */
 
-#define K_NB_CLIPS 1
\ No newline at end of file
+#define K_NB_CLIPS 1
+
+//Output Group Parameters
+#define kParamGroupOutput "groupOutput"
+
+#define kParamOutputMode "outputMode"
+#define kParamOutputExposure "outputExposure"
+#define kParamOutputWhitePoint "outputWhitePoint"
+
+/**
+ * @brief Image written by the merge
+ */
+enum EOutputMode
+{
+  eOutputModeRadiance = 0,
+  eOutputModeToneMapped
+};
\ No newline at end of file
@@ -29,16 +29,19 @@ void HdrMergePluginFactory::describe(OFX::ImageEffectDescriptor& desc)
   //Supported pixel depths
   desc.addSupportedBitDepth(OFX::eBitDepthUByte);
   desc.addSupportedBitDepth(OFX::eBitDepthUShort);
+  desc.addSupportedBitDepth(OFX::eBitDepthHalf);
   desc.addSupportedBitDepth(OFX::eBitDepthFloat);
 
   //Flags
   desc.setSingleInstance(false);
   desc.setHostFrameThreading(false);
+  desc.setRenderThreadSafety(OFX::eRenderFullySafe);
   desc.setSupportsMultiResolution(true);
-  desc.setSupportsTiles(false);
+  desc.setSupportsTiles(true);
   desc.setTemporalClipAccess(true);
   desc.setRenderTwiceAlways(false);
   desc.setSupportsMultipleClipPARs(false);
+  desc.setSupportsMultipleClipDepths(true); //float output of integer sources
 }
 
 void HdrMergePluginFactory::describeInContext(OFX::ImageEffectDescriptor& desc, OFX::ContextEnum context)
@@ -58,6 +61,55 @@ void HdrMergePluginFactory::describeInContext(OFX::ImageEffectDescriptor& desc,
   //Response group
   cameraColorCalibration::hdrBase::describeResponseGroup(desc, context, true);
   
+  //Performance group
+  cameraColorCalibration::hdrBase::describePerformanceGroup(desc, context);
+  
+  //Color group
+  cameraColorCalibration::hdrBase::describeColorGroup(desc, context);
+  
+  //Output group
+  {
+    OFX::GroupParamDescriptor *groupOutput = desc.defineGroupParam(kParamGroupOutput);
+    groupOutput->setLabel("Output");
+    groupOutput->setAsTab();
+    
+    {
+      OFX::ChoiceParamDescriptor *param = desc.defineChoiceParam(kParamOutputMode);
+      param->setLabel("Output Mode");
+      param->setHint("Radiance writes the merged radiance. Tone Mapped Preview applies a global Reinhard operator in the merge output write, for a display-ready review without a tone mapping node.");
+      param->appendOption("Radiance");
+      param->appendOption("Tone Mapped Preview");
+      param->setDefault(eOutputModeRadiance);
+      param->setAnimates(false);
+      param->setEvaluateOnChange(true);
+      param->setParent(*groupOutput);
+    }
+    
+    {
+      OFX::DoubleParamDescriptor *param = desc.defineDoubleParam(kParamOutputExposure);
+      param->setLabel("Exposure");
+      param->setHint("Tone mapped preview: stops added to the middle grey key (0.18) of the log-average luminance.");
+      param->setDefault(0);
+      param->setRange(-10, 10);
+      param->setDisplayRange(-4, 4);
+      param->setAnimates(true);
+      param->setEvaluateOnChange(true);
+      param->setParent(*groupOutput);
+    }
+    
+    {
+      OFX::DoubleParamDescriptor *param = desc.defineDoubleParam(kParamOutputWhitePoint);
+      param->setLabel("White Point");
+      param->setHint("Tone mapped preview: smallest luminance mapped to white, relative to the key scaled luminance. 0 is the plain Reinhard curve.");
+      param->setDefault(4);
+      param->setRange(0, 1000);
+      param->setDisplayRange(0, 16);
+      param->setAnimates(true);
+      param->setEvaluateOnChange(true);
+      param->setParent(*groupOutput);
+    }
+  }
+  
   //Debug group
   cameraColorCalibration::hdrBase::describeDebugGroup(desc, context);
   